@@ -0,0 +1,165 @@
+/**
+* @file arena.c
+* @author Ghufran Latif
+* @date 16 Oct. 2026
+* @Bump allocator for everything that lives only as long as one command line:
+ * the copy of the line that gets tokenized and the parsed commands. Memory
+ * comes from a chain of large chunks that is kept between commands, so after
+ * the first few commands the REPL no longer touches the heap.
+*/
+#include "arena.h"
+
+#include <stdio.h>
+
+#include "debug.h"
+
+#include <string.h>
+
+#include <stdlib.h>
+
+#include <stdint.h>
+
+/* Every allocation is aligned for any type: sizes are rounded up to this
+ * and chunk data starts aligned to it */
+#define ARENA_ALIGN _Alignof(max_align_t)
+
+/**
+ * Prepares an empty arena. No memory is allocated until the first request.
+ * @param a - arena to initialize
+ * @param chunk_sz - size of each chunk (ARENA_CHUNK_SZ unless testing)
+ */
+void arena_init(struct arena *a, size_t chunk_sz)
+{
+    a->head = NULL;
+    a->cur = NULL;
+    a->chunk_sz = chunk_sz;
+}
+
+/**
+ * Creates a chunk able to hold at least sz bytes
+ * @param a - the arena, for the default chunk size
+ * @param sz - size of the request that did not fit
+ * @return - the new chunk, or NULL on error
+ */
+static struct arena_chunk *new_chunk(struct arena *a, size_t sz)
+{
+    size_t cap = sz > a->chunk_sz ? sz : a->chunk_sz;
+    struct arena_chunk *chunk = malloc(sizeof(struct arena_chunk) + cap);
+    
+    if (chunk == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    chunk->next = NULL;
+    chunk->cap = cap;
+    chunk->used = 0;
+    return chunk;
+}
+
+/**
+ * Allocates sz bytes that stay valid until the next arena_reset
+ * @param a - arena to allocate from
+ * @param sz - number of bytes
+ * @return - the memory, or NULL on error
+ */
+void *arena_alloc(struct arena *a, size_t sz)
+{
+    struct arena_chunk *chunk = a->cur;
+    size_t start;
+    
+    sz = (sz + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1);
+    
+    /* Move along the chain (chunks kept from earlier commands come first)
+     * until one has room; add a chunk at the end if none does */
+    while (chunk == NULL || chunk->cap - chunk->used < sz) {
+        if (chunk == NULL) {
+            if (a->head == NULL) {
+                a->head = new_chunk(a, sz);
+            }
+            chunk = a->head;
+        } else if (chunk->next != NULL) {
+            chunk = chunk->next;
+        } else {
+            chunk->next = new_chunk(a, sz);
+            chunk = chunk->next;
+        }
+        if (chunk == NULL) {
+            return NULL;
+        }
+        if (chunk != a->cur) {
+            chunk->used = 0;
+        }
+        a->cur = chunk;
+    }
+    
+    start = chunk->used;
+    chunk->used += sz;
+    return chunk->data + start;
+}
+
+/**
+ * Allocates zeroed memory for n elements of sz bytes
+ * @param a - arena to allocate from
+ * @param n - number of elements
+ * @param sz - size of each element
+ * @return - the memory, or NULL on error
+ */
+void *arena_calloc(struct arena *a, size_t n, size_t sz)
+{
+    void *mem;
+    
+    if (sz != 0 && n > SIZE_MAX / sz) {
+        return NULL;
+    }
+    mem = arena_alloc(a, n * sz);
+    if (mem != NULL) {
+        memset(mem, 0, n * sz);
+    }
+    return mem;
+}
+
+/**
+ * Copies a string into the arena
+ * @param a - arena to allocate from
+ * @param s - string to copy
+ * @return - the copy, or NULL on error
+ */
+char *arena_strdup(struct arena *a, const char *s)
+{
+    size_t len = strlen(s);
+    char *copy = arena_alloc(a, len + 1);
+    
+    if (copy != NULL) {
+        memcpy(copy, s, len + 1);
+    }
+    return copy;
+}
+
+/**
+ * Releases every allocation at once. The chunks are kept for the next
+ * command; only the first one is rewound here, the others when reached.
+ * @param a - arena to reset
+ */
+void arena_reset(struct arena *a)
+{
+    a->cur = a->head;
+    if (a->head != NULL) {
+        a->head->used = 0;
+    }
+}
+
+/**
+ * Returns every chunk to the heap
+ * @param a - arena to free
+ */
+void arena_free(struct arena *a)
+{
+    struct arena_chunk *chunk = a->head;
+    
+    while (chunk != NULL) {
+        struct arena_chunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena_init(a, a->chunk_sz);
+}
@@ -0,0 +1,45 @@
+/**
+* @file arena.h
+* @author Ghufran Latif
+* @date 16 Oct. 2026
+* @Header file for arena.c, the per-command bump allocator
+*/
+#include <stddef.h>
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+/**
+ * Default size of an arena chunk. One chunk holds everything a typical
+ * command line needs.
+ */
+#define ARENA_CHUNK_SZ 65536
+
+/**
+ * Block of arena memory. Chunks are chained and kept across resets. The
+ * header is padded so data starts aligned for any type, like malloc.
+ */
+struct arena_chunk {
+    struct arena_chunk *next;
+    size_t cap;
+    size_t used;
+    _Alignas(max_align_t) char data[];
+};
+
+/**
+ * Bump allocator: allocations are never freed one by one; arena_reset
+ * releases all of them at once.
+ */
+struct arena {
+    struct arena_chunk *head;
+    struct arena_chunk *cur;
+    size_t chunk_sz;
+};
+
+void arena_init(struct arena *a, size_t chunk_sz);
+void *arena_alloc(struct arena *a, size_t sz);
+void *arena_calloc(struct arena *a, size_t n, size_t sz);
+char *arena_strdup(struct arena *a, const char *s);
+void arena_reset(struct arena *a);
+void arena_free(struct arena *a);
+
+#endif
@@ -0,0 +1,23 @@
+#!/usr/bin/env bash
+# Launch microbenchmark: runs a script of short commands through crash with
+# each launch path and reports commands per second.
+#
+# Usage: ./bench.sh [commands]   (default: 2000)
+
+count=${1:-2000}
+script=$(mktemp)
+trap 'rm -f "${script}"' EXIT
+
+for (( i = 0; i < count / 2; i++ )); do
+    echo "true"
+    echo "true | true"
+done > "${script}"
+
+for launch in fork spawn; do
+    start=$(date +%s%N)
+    CRASH_LAUNCH=${launch} ./crash < "${script}" > /dev/null 2>&1
+    end=$(date +%s%N)
+    awk -v l="${launch}" -v n="${count}" -v ns=$(( end - start )) 'BEGIN {
+        printf "%-6s %6d commands in %7.3f s: %8.0f commands/s\n", l, n, ns / 1e9, n * 1e9 / ns
+    }'
+done
@@ -0,0 +1,335 @@
+/**
+* @file builtins.c
+* @author Ghufran Latif
+* @date 16 Oct. 2026
+* @Builtin commands and the table they are looked up in. A builtin runs in
+ * the shell process when it is a command of its own (see execute_pipeline)
+ * and in a forked child when it is a stage of a pipeline or runs in the
+ * background. The table is sorted by name and looked up with a switch on
+ * the first letter, so most names are told apart by one strcmp.
+*/
+#include "builtins.h"
+
+#include <stdio.h>
+
+#include "cmdhash.h"
+#include "debug.h"
+#include "history.h"
+#include "jobs.h"
+#include "parallel.h"
+#include "profile.h"
+#include "shell.h"
+
+#include <string.h>
+
+#include <stdlib.h>
+
+#include <unistd.h>
+
+#include <limits.h>
+
+#include <pwd.h>
+
+extern char **environ;
+
+/**
+ * cd [dir]: changes directory, to the home directory without dir
+ * @param args - the command line
+ * @return - 0, or 1 on error
+ */
+static int cd_builtin(char *args[])
+{
+    const char *dir = args[1];
+    
+    if (dir == NULL) {
+        struct passwd *pw = getpwuid(getuid());
+        dir = getenv("HOME");
+        if (dir == NULL && pw != NULL) {
+            dir = pw->pw_dir;
+        }
+        if (dir == NULL) {
+            fprintf(stderr, "cd: no home directory\n");
+            return 1;
+        }
+    }
+    if (chdir(dir) != 0) {
+        perror("cd");
+        return 1;
+    }
+    prompt_update_cwd();
+    return 0;
+}
+
+/**
+ * pwd: prints the working directory
+ * @param args - the command line
+ * @return - 0, or 1 on error
+ */
+static int pwd_builtin(char *args[])
+{
+    char cwd[PATH_MAX];
+    
+    if (getcwd(cwd, sizeof(cwd)) == NULL) {
+        perror("pwd");
+        return 1;
+    }
+    printf("%s\n", cwd);
+    return 0;
+}
+
+/**
+ * echo [-n] [word ...]: prints the words separated by spaces
+ * @param args - the command line
+ * @return - 0
+ */
+static int echo_builtin(char *args[])
+{
+    bool newline = true;
+    int i = 1;
+    
+    if (args[1] != NULL && strcmp(args[1], "-n") == 0) {
+        newline = false;
+        i++;
+    }
+    for (int first = i; args[i] != NULL; i++) {
+        if (i > first) {
+            putchar(' ');
+        }
+        fputs(args[i], stdout);
+    }
+    if (newline) {
+        putchar('\n');
+    }
+    return 0;
+}
+
+/**
+ * Sets an environment variable, forgetting the command paths if it is PATH
+ * @param name - the variable
+ * @param value - its value, or NULL to unset it
+ * @return - 0, or 1 on error
+ */
+static int set_variable(const char *name, const char *value)
+{
+    int rv = value != NULL ? setenv(name, value, true) : unsetenv(name);
+    
+    if (rv == -1) {
+        perror(name);
+        return 1;
+    }
+    if (strcmp(name, "PATH") == 0) {
+        cmdhash_clear(); // remembered paths may now resolve differently
+    }
+    return 0;
+}
+
+/**
+ * setenv NAME VALUE
+ * @param args - the command line
+ * @return - 0, 1 on error, 2 on a usage error
+ */
+static int setenv_builtin(char *args[])
+{
+    if (args[1] == NULL || args[2] == NULL) {
+        fprintf(stderr, "setenv: usage: setenv NAME VALUE\n");
+        return 2;
+    }
+    return set_variable(args[1], args[2]);
+}
+
+/**
+ * export [NAME=VALUE ...]: sets variables, or lists them without arguments.
+ * Every variable is passed on to commands, so "export NAME" has nothing to
+ * do.
+ * @param args - the command line
+ * @return - 0, or 1 if any failed
+ */
+static int export_builtin(char *args[])
+{
+    int rv = 0;
+    
+    if (args[1] == NULL) {
+        for (char **env = environ; *env != NULL; env++) {
+            printf("export %s\n", *env);
+        }
+        return 0;
+    }
+    for (int i = 1; args[i] != NULL; i++) {
+        char *eq = strchr(args[i], '=');
+        if (eq != NULL) {
+            *eq = '\0';
+            rv |= set_variable(args[i], eq + 1);
+            *eq = '=';
+        }
+    }
+    return rv;
+}
+
+/**
+ * unset NAME ...: removes variables
+ * @param args - the command line
+ * @return - 0, or 1 if any failed
+ */
+static int unset_builtin(char *args[])
+{
+    int rv = 0;
+    
+    for (int i = 1; args[i] != NULL; i++) {
+        rv |= set_variable(args[i], NULL);
+    }
+    return rv;
+}
+
+/**
+ * type NAME ...: tells whether each name is a builtin or where it is found
+ * @param args - the command line
+ * @return - 0, or 1 if any was not found
+ */
+static int type_builtin(char *args[])
+{
+    int rv = 0;
+    
+    for (int i = 1; args[i] != NULL; i++) {
+        const char *path;
+        
+        if (is_builtin(args[i])) {
+            printf("%s is a shell builtin\n", args[i]);
+        } else if ((path = cmdhash_lookup(args[i])) != NULL) {
+            printf("%s is %s\n", args[i], path);
+        } else {
+            fprintf(stderr, "type: %s: not found\n", args[i]);
+            rv = 1;
+        }
+    }
+    return rv;
+}
+
+/**
+ * true: does nothing, successfully
+ * @param args - the command line
+ * @return - 0
+ */
+static int true_builtin(char *args[])
+{
+    return 0;
+}
+
+/**
+ * false: does nothing, unsuccessfully
+ * @param args - the command line
+ * @return - 1
+ */
+static int false_builtin(char *args[])
+{
+    return 1;
+}
+
+/**
+ * exit [N]: exits the shell with status N (0 by default)
+ * @param args - the command line
+ * @return - only if the argument is not a number
+ */
+static int exit_builtin(char *args[])
+{
+    char *end;
+    long code = 0;
+    
+    if (args[1] != NULL) {
+        code = strtol(args[1], &end, 10);
+        if (*end != '\0' || end == args[1]) {
+            fprintf(stderr, "exit: %s: numeric argument required\n", args[1]);
+            return 2;
+        }
+    }
+    shell_exit(code & 0xff);
+    return 0;
+}
+
+enum builtin_id {
+    BI_BG, BI_CD, BI_ECHO, BI_EXIT, BI_EXPORT, BI_FALSE, BI_FG, BI_HASH,
+    BI_HISTORY, BI_JOBS, BI_PARALLEL, BI_PWD, BI_SETENV, BI_TIME, BI_TRUE,
+    BI_TYPE, BI_UNSET, BI_WAIT,
+};
+
+static const struct builtin builtins[] = {
+    [BI_BG] = { "bg", bg_builtin, NULL },
+    [BI_CD] = { "cd", cd_builtin, NULL },
+    [BI_ECHO] = { "echo", echo_builtin, NULL },
+    [BI_EXIT] = { "exit", exit_builtin, NULL },
+    [BI_EXPORT] = { "export", export_builtin, NULL },
+    [BI_FALSE] = { "false", false_builtin, NULL },
+    [BI_FG] = { "fg", fg_builtin, NULL },
+    [BI_HASH] = { "hash", cmdhash_builtin, NULL },
+    [BI_HISTORY] = { "history", history_builtin, NULL },
+    [BI_JOBS] = { "jobs", jobs_builtin, NULL },
+    [BI_PARALLEL] = { "parallel", NULL, parallel_builtin },
+    [BI_PWD] = { "pwd", pwd_builtin, NULL },
+    [BI_SETENV] = { "setenv", setenv_builtin, NULL },
+    [BI_TIME] = { "time", NULL, time_builtin },
+    [BI_TRUE] = { "true", true_builtin, NULL },
+    [BI_TYPE] = { "type", type_builtin, NULL },
+    [BI_UNSET] = { "unset", unset_builtin, NULL },
+    [BI_WAIT] = { "wait", wait_builtin, NULL },
+};
+
+/**
+ * Compares a name with a range of the table
+ * @param name - the command name
+ * @param first - first entry to compare with
+ * @param last - last entry to compare with
+ * @return - the builtin, or NULL
+ */
+static const struct builtin *find_in(const char *name, enum builtin_id first, enum builtin_id last)
+{
+    for (int i = first; i <= last; i++) {
+        if (strcmp(builtins[i].name, name) == 0) {
+            return &builtins[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Looks a command name up in the builtin table
+ * @param name - the command name
+ * @return - the builtin, or NULL if it is not one
+ */
+const struct builtin *builtin_find(const char *name)
+{
+    switch (name[0]) {
+    case 'b': return find_in(name, BI_BG, BI_BG);
+    case 'c': return find_in(name, BI_CD, BI_CD);
+    case 'e': return find_in(name, BI_ECHO, BI_EXPORT);
+    case 'f': return find_in(name, BI_FALSE, BI_FG);
+    case 'h': return find_in(name, BI_HASH, BI_HISTORY);
+    case 'j': return find_in(name, BI_JOBS, BI_JOBS);
+    case 'p': return find_in(name, BI_PARALLEL, BI_PWD);
+    case 's': return find_in(name, BI_SETENV, BI_SETENV);
+    case 't': return find_in(name, BI_TIME, BI_TYPE);
+    case 'u': return find_in(name, BI_UNSET, BI_UNSET);
+    case 'w': return find_in(name, BI_WAIT, BI_WAIT);
+    default: return NULL;
+    }
+}
+
+/**
+ * Tells whether a command is a builtin
+ * @param name - the command name
+ * @return - true for a builtin
+ */
+bool is_builtin(const char *name)
+{
+    return builtin_find(name) != NULL;
+}
+
+/**
+ * Tells whether a command is a builtin that takes the whole command line
+ * @param name - the command name
+ * @return - true for such a builtin
+ */
+bool is_line_builtin(const char *name)
+{
+    const struct builtin *b = builtin_find(name);
+    
+    return b != NULL && b->run_line != NULL;
+}
@@ -0,0 +1,29 @@
+/**
+* @file builtins.h
+* @author Ghufran Latif
+* @date 16 Oct. 2026
+* @Header file for builtins.c, the builtin command table
+*/
+#ifndef _BUILTINS_H_
+#define _BUILTINS_H_
+#include <stdbool.h>
+
+struct arena;
+struct token;
+
+/**
+ * One builtin. Most take the argv of their pipeline stage and return an
+ * exit code; run_line builtins take the whole command line instead (e.g.
+ * parallel, whose command may be a pipeline of its own).
+ */
+struct builtin {
+    const char *name;
+    int (*run)(char *args[]);
+    int (*run_line)(struct token *toks, int ntok, struct arena *arena);
+};
+
+const struct builtin *builtin_find(const char *name);
+bool is_builtin(const char *name);
+bool is_line_builtin(const char *name);
+
+#endif
@@ -0,0 +1,243 @@
+/**
+* @file cmdhash.c
+* @author Ghufran Latif
+* @date 16 Oct. 2026
+* @Remembers where each command was found in $PATH, so running it again does
+ * not stat every $PATH directory. Open addressing (linear probing) table
+ * keyed by command name, filled on first use and emptied when PATH changes.
+*/
+#define _GNU_SOURCE
+#include "cmdhash.h"
+
+#include <stdio.h>
+
+#include "debug.h"
+
+#include <string.h>
+
+#include <stdlib.h>
+
+#include <stdbool.h>
+
+#include <unistd.h>
+
+#include <limits.h>
+
+#include <sys/stat.h>
+
+static struct cmdhash_entry *table = NULL;
+static size_t table_cap = 0;   // always a power of two
+static size_t table_count = 0;
+
+/**
+ * FNV-1a hash of a command name
+ * @param name - string to hash
+ * @return - the hash
+ */
+static size_t hash_name(const char *name)
+{
+    size_t h = 14695981039346656037ULL;
+    
+    while (*name) {
+        h ^= (unsigned char) *name++;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/**
+ * Finds the slot of a name: either the slot holding it or the empty slot
+ * where it would go
+ * @param name - command name
+ * @return - the slot
+ */
+static struct cmdhash_entry *find_slot(const char *name)
+{
+    size_t i = hash_name(name) & (table_cap - 1);
+    
+    while (table[i].name != NULL && strcmp(table[i].name, name) != 0) {
+        i = (i + 1) & (table_cap - 1);
+    }
+    return &table[i];
+}
+
+/**
+ * Doubles the table (or creates it), re-inserting every entry
+ * @return - 0 on success, -1 on error
+ */
+static int grow_table()
+{
+    struct cmdhash_entry *old = table;
+    size_t old_cap = table_cap;
+    size_t new_cap = table_cap == 0 ? 64 : table_cap * 2;
+    struct cmdhash_entry *grown = calloc(new_cap, sizeof(struct cmdhash_entry));
+    
+    if (grown == NULL) {
+        perror("calloc");
+        return -1;
+    }
+    table = grown;
+    table_cap = new_cap;
+    for (size_t i = 0; i < old_cap; i++) {
+        if (old[i].name != NULL) {
+            *find_slot(old[i].name) = old[i];
+        }
+    }
+    free(old);
+    return 0;
+}
+
+/**
+ * Walks $PATH the way execvp does, looking for an executable regular file
+ * @param name - command name (without a '/')
+ * @return - newly allocated absolute path, or NULL if it was not found
+ */
+static char *search_path(const char *name)
+{
+    const char *path_env = getenv("PATH");
+    char candidate[PATH_MAX];
+    struct stat st;
+    
+    if (path_env == NULL) {
+        path_env = "/bin:/usr/bin";
+    }
+    while (true) {
+        const char *colon = strchrnul(path_env, ':');
+        int dir_len = colon - path_env;
+        
+        /* An empty entry means the current directory */
+        if (snprintf(candidate, sizeof(candidate), "%.*s%s%s", dir_len, path_env,
+                     dir_len > 0 ? "/" : "", name) < (int) sizeof(candidate)
+                && stat(candidate, &st) == 0 && S_ISREG(st.st_mode)
+                && access(candidate, X_OK) == 0) {
+            return strdup(candidate);
+        }
+        if (*colon == '\0') {
+            return NULL;
+        }
+        path_env = colon + 1;
+    }
+}
+
+/**
+ * Resolves a command to the path to execute, searching $PATH only the first
+ * time a name is seen. Names containing a '/' are returned as they are.
+ * @param name - command name
+ * @return - path to execute, or NULL if the command was not found
+ */
+const char *cmdhash_lookup(const char *name)
+{
+    struct cmdhash_entry *slot;
+    char *path;
+    
+    if (strchr(name, '/') != NULL) {
+        return name;
+    }
+    if (table_cap > 0) {
+        slot = find_slot(name);
+        if (slot->name != NULL) {
+            slot->hits++;
+            return slot->path;
+        }
+    }
+    
+    path = search_path(name);
+    if (path == NULL) {
+        return NULL;
+    }
+    /* Keep the load factor at or below 1/2 */
+    if ((table_count + 1) * 2 > table_cap && grow_table() == -1) {
+        free(path);
+        return NULL;
+    }
+    slot = find_slot(name);
+    slot->name = strdup(name);
+    slot->path = path;
+    slot->hits = 1;
+    table_count++;
+    LOG("Hashed %s -> %s\n", name, path);
+    return path;
+}
+
+/**
+ * Searches $PATH again for a remembered command, e.g. after its cached path
+ * stopped existing
+ * @param name - command name
+ * @return - the new path, or NULL if the command is gone
+ */
+const char *cmdhash_refresh(const char *name)
+{
+    struct cmdhash_entry *slot;
+    char *path;
+    
+    if (table_cap == 0 || strchr(name, '/') != NULL) {
+        return NULL;
+    }
+    slot = find_slot(name);
+    if (slot->name == NULL || (path = search_path(name)) == NULL) {
+        return NULL;
+    }
+    free(slot->path);
+    slot->path = path;
+    return path;
+}
+
+/**
+ * Forgets every remembered command (e.g. when $PATH changes)
+ */
+void cmdhash_clear()
+{
+    for (size_t i = 0; i < table_cap; i++) {
+        free(table[i].name);
+        free(table[i].path);
+    }
+    free(table);
+    table = NULL;
+    table_cap = 0;
+    table_count = 0;
+}
+
+/**
+ * Prints the remembered commands and how often each was used
+ */
+void cmdhash_print()
+{
+    if (table_count == 0) {
+        printf("hash: hash table empty\n");
+        return;
+    }
+    printf("hits\tcommand\n");
+    for (size_t i = 0; i < table_cap; i++) {
+        if (table[i].name != NULL) {
+            printf("%4u\t%s\n", table[i].hits, table[i].path);
+        }
+    }
+    fflush(stdout);
+}
+
+/**
+ * The hash builtin. "hash" lists the table, "hash -r" empties it and
+ * "hash name..." looks the names up and remembers them.
+ * @param args - NULL terminated argument array, args[0] is "hash"
+ * @return - 0 on success, 1 if a name could not be found
+ */
+int cmdhash_builtin(char *args[])
+{
+    int rv = 0;
+    
+    if (args[1] == NULL) {
+        cmdhash_print();
+        return 0;
+    }
+    if (strcmp(args[1], "-r") == 0) {
+        cmdhash_clear();
+        return 0;
+    }
+    for (int i = 1; args[i] != NULL; i++) {
+        if (cmdhash_lookup(args[i]) == NULL) {
+            fprintf(stderr, "crash: hash: %s: not found\n", args[i]);
+            rv = 1;
+        }
+    }
+    return rv;
+}
@@ -0,0 +1,25 @@
+/**
+* @file cmdhash.h
+* @author Ghufran Latif
+* @date 16 Oct. 2026
+* @Header file for cmdhash.c, the command name to path table
+*/
+#ifndef _CMDHASH_H_
+#define _CMDHASH_H_
+
+/**
+ * One remembered command
+ */
+struct cmdhash_entry {
+    char *name;
+    char *path;
+    unsigned int hits;
+};
+
+const char *cmdhash_lookup(const char *name);
+const char *cmdhash_refresh(const char *name);
+void cmdhash_clear();
+void cmdhash_print();
+int cmdhash_builtin(char *args[]);
+
+#endif
@@ -0,0 +1,244 @@
+/**
+* @file histindex.c
+* @author Ghufran Latif
+* @date 16 Oct. 2026
+* @Prefix index over the history, for "!prefix". Every prefix of up to
+ * HISTINDEX_DEPTH bytes of every entry is a key of an open addressing
+ * (linear probing) table that gives the newest entry starting with it.
+ * Entries are added newest last and removed oldest first, so the newest
+ * entry of a key only changes on insert.
+*/
+#include "histindex.h"
+
+#include <stdio.h>
+
+#include "debug.h"
+
+#include <string.h>
+
+#include <stdlib.h>
+
+static struct histindex_slot *table = NULL;
+static size_t table_cap = 0;    // always a power of two
+static size_t table_count = 0;
+static struct histindex_entry *entries = NULL;
+static uint64_t entries_cap = 0;   // one per history entry, indexed by seq % entries_cap
+
+/**
+ * Hash of a key
+ * @param bytes - the prefix, zero padded
+ * @param len - its length
+ * @return - the hash
+ */
+static size_t hash_key(uint64_t bytes, uint8_t len)
+{
+    uint64_t h = (bytes ^ len) * 0x9E3779B97F4A7C15ULL;
+    
+    return h ^ (h >> 29);
+}
+
+/**
+ * Finds the slot of a key: the slot holding it or the empty slot where it
+ * would go
+ * @param bytes - the prefix, zero padded
+ * @param len - its length
+ * @return - the slot
+ */
+static struct histindex_slot *find_slot(uint64_t bytes, uint8_t len)
+{
+    size_t i = hash_key(bytes, len) & (table_cap - 1);
+    
+    while (table[i].live != 0 && (table[i].bytes != bytes || table[i].len != len)) {
+        i = (i + 1) & (table_cap - 1);
+    }
+    return &table[i];
+}
+
+/**
+ * Doubles the table
+ * @return - 0, or -1 if out of memory
+ */
+static int grow_table()
+{
+    struct histindex_slot *old = table;
+    size_t old_cap = table_cap;
+    
+    table = calloc(old_cap * 2, sizeof(struct histindex_slot));
+    if (table == NULL) {
+        table = old;
+        return -1;
+    }
+    table_cap = old_cap * 2;
+    for (size_t i = 0; i < old_cap; i++) {
+        if (old[i].live != 0) {
+            *find_slot(old[i].bytes, old[i].len) = old[i];
+        }
+    }
+    free(old);
+    return 0;
+}
+
+/**
+ * Empties a slot, moving later slots of the same probe run back so every
+ * key can still be reached from its home slot
+ * @param slot - the slot
+ */
+static void delete_slot(struct histindex_slot *slot)
+{
+    size_t i = slot - table;
+    size_t j = i;
+    
+    table[i].live = 0;
+    while (true) {
+        size_t home;
+    
+        j = (j + 1) & (table_cap - 1);
+        if (table[j].live == 0) {
+            break;
+        }
+        home = hash_key(table[j].bytes, table[j].len) & (table_cap - 1);
+        /* Move j back to i unless its home lies cyclically in (i, j] */
+        if ((j > i && (home <= i || home > j)) || (j < i && home <= i && home > j)) {
+            table[i] = table[j];
+            table[j].live = 0;
+            i = j;
+        }
+    }
+    table_count--;
+}
+
+/**
+ * Keeps only the first len bytes of a zero padded prefix
+ * @param bytes - the prefix
+ * @param len - bytes to keep, 1 to HISTINDEX_DEPTH
+ * @return - the shortened prefix
+ */
+static uint64_t key_bytes(uint64_t bytes, size_t len)
+{
+    return len == 8 ? bytes : bytes & ((1ULL << (len * 8)) - 1);
+}
+
+/**
+ * Prepares an empty index
+ * @param capacity - number of entries the history keeps
+ * @return - 0, or -1 if out of memory
+ */
+int histindex_init(uint64_t capacity)
+{
+    histindex_free();
+    entries = calloc(capacity, sizeof(struct histindex_entry));
+    table_cap = 1024;
+    table = calloc(table_cap, sizeof(struct histindex_slot));
+    if (entries == NULL || table == NULL) {
+        histindex_free();
+        return -1;
+    }
+    entries_cap = capacity;
+    return 0;
+}
+
+/**
+ * Adds an entry under each of its prefixes. It must be newer than every
+ * entry in the index, and the entry capacity places before it removed.
+ * @param seq - entry number - 1
+ * @param line - its line
+ */
+void histindex_insert(uint64_t seq, const char *line)
+{
+    struct histindex_entry *e = &entries[seq % entries_cap];
+    size_t len = strnlen(line, HISTINDEX_DEPTH);
+    
+    e->bytes = 0;
+    memcpy(&e->bytes, line, len);
+    e->len = len;
+    e->prev = HISTINDEX_NONE;
+    e->present = true;
+    
+    for (size_t l = 1; l <= len; l++) {
+        struct histindex_slot *slot;
+    
+        if ((table_count + 1) * 2 > table_cap && grow_table() == -1) {
+            e->len = l - 1; // the shorter prefixes are indexed; good enough
+            return;
+        }
+        slot = find_slot(key_bytes(e->bytes, l), l);
+        if (slot->live == 0) {
+            slot->bytes = key_bytes(e->bytes, l);
+            slot->len = l;
+            table_count++;
+        } else if (l == HISTINDEX_DEPTH) {
+            e->prev = slot->latest;
+        }
+        slot->latest = seq;
+        slot->live++;
+    }
+}
+
+/**
+ * Removes an entry. It must be the oldest one in the index.
+ * @param seq - entry number - 1
+ */
+void histindex_remove(uint64_t seq)
+{
+    struct histindex_entry *e = &entries[seq % entries_cap];
+    
+    if (!e->present) {
+        return;
+    }
+    for (size_t l = 1; l <= e->len; l++) {
+        struct histindex_slot *slot = find_slot(key_bytes(e->bytes, l), l);
+    
+        if (slot->live != 0 && --slot->live == 0) {
+            delete_slot(slot);
+        }
+    }
+    e->present = false;
+}
+
+/**
+ * Finds the newest entry starting with a prefix
+ * @param prefix - the prefix; only its first len bytes are used
+ * @param len - 1 to HISTINDEX_DEPTH
+ * @param seq - set to the entry number - 1
+ * @return - true if there is one
+ */
+bool histindex_latest(const char *prefix, size_t len, uint64_t *seq)
+{
+    struct histindex_slot *slot;
+    uint64_t bytes = 0;
+    
+    if (table == NULL) {
+        return false;
+    }
+    memcpy(&bytes, prefix, len);
+    slot = find_slot(bytes, len);
+    if (slot->live == 0) {
+        return false;
+    }
+    *seq = slot->latest;
+    return true;
+}
+
+/**
+ * Follows the chain of entries sharing their first HISTINDEX_DEPTH bytes
+ * @param seq - entry number - 1 of an entry in the index
+ * @return - the next older one, or HISTINDEX_NONE
+ */
+uint64_t histindex_prev(uint64_t seq)
+{
+    return entries[seq % entries_cap].prev;
+}
+
+/**
+ * Frees the index
+ */
+void histindex_free()
+{
+    free(table);
+    free(entries);
+    table = NULL;
+    entries = NULL;
+    table_cap = 0;
+    table_count = 0;
+    entries_cap = 0;
+}
@@ -0,0 +1,55 @@
+/**
+* @file histindex.h
+* @author Ghufran Latif
+* @date 16 Oct. 2026
+* @Header file for histindex.c, the prefix index over the history
+*/
+#ifndef _HISTINDEX_H_
+#define _HISTINDEX_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Longest prefix that is a key of the index. Longer prefixes are found by
+ * following the chain of entries that share their first HISTINDEX_DEPTH
+ * bytes.
+ */
+#define HISTINDEX_DEPTH 8
+
+/**
+ * Marks the end of a chain
+ */
+#define HISTINDEX_NONE UINT64_MAX
+
+/**
+ * One prefix (up to HISTINDEX_DEPTH bytes, stored in `bytes`) and the
+ * newest entry that starts with it. `live` counts the entries in the index
+ * that start with it; a slot with live == 0 is empty.
+ */
+struct histindex_slot {
+    uint64_t bytes;
+    uint64_t latest;
+    uint32_t live;
+    uint8_t len;
+};
+
+/**
+ * What the index remembers about an entry, so it can be removed after its
+ * line has been overwritten
+ */
+struct histindex_entry {
+    uint64_t bytes;     // first HISTINDEX_DEPTH bytes of the line, zero padded
+    uint64_t prev;      // older entry with the same HISTINDEX_DEPTH bytes
+    uint8_t len;        // number of prefixes it was added under
+    bool present;
+};
+
+int histindex_init(uint64_t capacity);
+void histindex_insert(uint64_t seq, const char *line);
+void histindex_remove(uint64_t seq);
+bool histindex_latest(const char *prefix, size_t len, uint64_t *seq);
+uint64_t histindex_prev(uint64_t seq);
+void histindex_free();
+
+#endif
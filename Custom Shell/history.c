@@ -3,13 +3,21 @@
 * @author Ghufran Latif
 * @date 1 Nov. 2019
 * @History
- * Contains all the functions that you use the history array for better encapsulation
+ * Contains all the functions that you use the history array for better encapsulation.
+ * The history lives in a file ($CRASH_HISTFILE, ~/.crash_history by default)
+ * that is mapped into memory, so nothing is parsed at startup and every
+ * shell sharing the file sees the others' commands. Adding an entry writes
+ * one index record and one line, under an flock, so shells can add to the
+ * same file at once.
 */
+#define _GNU_SOURCE
 #include "history.h"
 
 #include <stdio.h>
 
 #include "debug.h"
+#include "histindex.h"
+#include "strsearch.h"
 
 #include <string.h>
 
@@ -19,42 +27,372 @@
 
 #include <stdbool.h>
 
-#define HIST_MAX 100
+#include <fcntl.h>
 
+#include <unistd.h>
 
+#include <sys/file.h>
 
-struct history_entry h_ent[HIST_MAX];
-int history_count = 0;
-int start = 0;
-int end = -1;
-int tempIndex = 0;
+#include <sys/mman.h>
 
+#include <sys/stat.h>
+
+
+static struct history_header *hdr = NULL;
+static struct history_record *records;
+static char *strings;
+static size_t map_len = 0;
+static int hist_fd = -1;    // -1 when the history is only kept in memory
+static bool index_ready = false;    // the prefix index is built on the first "!prefix"
+static uint64_t index_lo = 0;       // entries in the prefix index
+static uint64_t index_hi = 0;
+
+
+/**
+ * Size of a history file
+ * @param capacity - number of index records
+ * @param str_cap - bytes of string space
+ * @return - the size in bytes
+ */
+static size_t history_size(uint64_t capacity, uint64_t str_cap)
+{
+    return sizeof(struct history_header) + capacity * sizeof(struct history_record) + str_cap;
+}
+
+/**
+ * Fills in the header of an empty history
+ * @param h - the header
+ * @param capacity - number of entries to keep
+ */
+static void history_format(struct history_header *h, uint64_t capacity)
+{
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, HIST_MAGIC, sizeof(h->magic));
+    h->version = HIST_VERSION;
+    h->record_size = sizeof(struct history_record);
+    h->capacity = capacity;
+    h->str_cap = capacity * HIST_AVG_LINE;
+}
+
+/**
+ * Maps the history file, creating it if it is empty. The file is locked
+ * meanwhile, so two shells starting at once do not both create it.
+ * @param path - the file
+ * @param capacity - number of entries for a new file
+ * @return - the mapping, or NULL if the file cannot be used
+ */
+static void *history_map_file(const char *path, uint64_t capacity)
+{
+    struct history_header h;
+    struct stat st;
+    void *map = NULL;
+    
+    hist_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (hist_fd == -1) {
+        perror(path);
+        return NULL;
+    }
+    flock(hist_fd, LOCK_EX);
+    if (fstat(hist_fd, &st) == -1) {
+        perror(path);
+    } else if (st.st_size == 0) {
+        history_format(&h, capacity);
+        if (ftruncate(hist_fd, history_size(h.capacity, h.str_cap)) == -1
+            || pwrite(hist_fd, &h, sizeof(h), 0) != sizeof(h)) {
+            perror(path);
+        } else {
+            map_len = history_size(h.capacity, h.str_cap);
+        }
+    } else if (pread(hist_fd, &h, sizeof(h), 0) != sizeof(h)
+               || memcmp(h.magic, HIST_MAGIC, sizeof(h.magic)) != 0
+               || h.version != HIST_VERSION
+               || h.record_size != sizeof(struct history_record)
+               || h.capacity == 0 || h.str_cap == 0
+               || (uint64_t) st.st_size != history_size(h.capacity, h.str_cap)) {
+        fprintf(stderr, "crash: %s is not a history file, keeping history in memory\n", path);
+    } else {
+        map_len = st.st_size; // the capacity of an existing file wins
+    }
+    
+    if (map_len > 0) {
+        map = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, hist_fd, 0);
+        if (map == MAP_FAILED) {
+            perror("mmap");
+            map = NULL;
+        }
+    }
+    flock(hist_fd, LOCK_UN);
+    if (map == NULL) {
+        close(hist_fd);
+        hist_fd = -1;
+        map_len = 0;
+    }
+    return map;
+}
+
+/**
+ * Opens the history. With a path the history is kept in (and shared
+ * through) that file; without one, or if the file cannot be used, it is
+ * kept in memory the same way and lost on exit.
+ * @param path - the history file, or NULL
+ * @param capacity - number of entries to keep, 0 for HIST_DEFAULT_SIZE
+ * @return - 0 if the file is used, -1 if the history is in memory
+ */
+int history_open(const char *path, unsigned long capacity)
+{
+    void *map = NULL;
+    
+    if (capacity == 0 || capacity > HIST_MAX_SIZE) {
+        capacity = HIST_DEFAULT_SIZE;
+    }
+    if (path != NULL) {
+        map = history_map_file(path, capacity);
+    }
+    if (map == NULL) {
+        struct history_header h;
+        
+        history_format(&h, capacity);
+        map_len = history_size(h.capacity, h.str_cap);
+        map = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (map == MAP_FAILED) {
+            perror("mmap");
+            exit(EXIT_FAILURE);
+        }
+        memcpy(map, &h, sizeof(h));
+    }
+    
+    hdr = map;
+    records = (struct history_record *) (hdr + 1);
+    strings = (char *) (records + hdr->capacity);
+    LOG("History: %s, %lu of %lu entries\n", hist_fd != -1 ? path : "in memory",
+        (unsigned long) (hdr->count < hdr->capacity ? hdr->count : hdr->capacity),
+        (unsigned long) hdr->capacity);
+    return hist_fd != -1 ? 0 : -1;
+}
+
+/**
+ * Unmaps the history
+ */
+void history_close()
+{
+    if (hdr != NULL) {
+        munmap(hdr, map_len);
+        hdr = NULL;
+    }
+    if (index_ready) {
+        histindex_free();
+        index_ready = false;
+    }
+    if (hist_fd != -1) {
+        close(hist_fd);
+        hist_fd = -1;
+    }
+}
+
+/**
+ * Number of entries ever added, including those added by other shells.
+ * Pairs with the release store in add_entry, so the records and lines of
+ * the entries counted are complete.
+ * @return - the count
+ */
+static uint64_t history_count()
+{
+    return __atomic_load_n(&hdr->count, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Gets the line of an entry
+ * @param seq - entry number - 1
+ * @param count - history_count()
+ * @return - the line, or NULL if the entry does not exist (any more)
+ */
+static char *entry_line(uint64_t seq, uint64_t count)
+{
+    const struct history_record *rec;
+    
+    if (seq >= count || count - seq > hdr->capacity) {
+        return NULL;
+    }
+    rec = &records[seq % hdr->capacity];
+    if (hdr->str_head - rec->str_off > hdr->str_cap) {
+        return NULL; // its line was overwritten by newer ones
+    }
+    return strings + rec->str_off % hdr->str_cap;
+}
+
+/**
+ * Finds the oldest entry that is still kept
+ * @param count - history_count()
+ * @return - its number - 1
+ */
+static uint64_t oldest_entry(uint64_t count)
+{
+    uint64_t seq = count > hdr->capacity ? count - hdr->capacity : 0;
+    
+    while (seq < count && entry_line(seq, count) == NULL) {
+        seq++;
+    }
+    return seq;
+}
+
+/**
+ * Brings the prefix index up to date: entries that left the ring are
+ * removed and those added since (by this shell or another one) are added
+ * @param count - history_count()
+ */
+static void sync_index(uint64_t count)
+{
+    uint64_t lo = count > hdr->capacity ? count - hdr->capacity : 0;
+    
+    while (index_lo < index_hi && index_lo < lo) {
+        histindex_remove(index_lo++);
+    }
+    if (index_hi < lo) {
+        index_lo = index_hi = lo;
+    }
+    for (; index_hi < count; index_hi++) {
+        char *line = entry_line(index_hi, count);
+        if (line != NULL) {
+            histindex_insert(index_hi, line);
+        }
+    }
+}
+
+/**
+ * Number the next entry will get, e.g. for the prompt
+ * @return - the number
+ */
+unsigned int history_next()
+{
+    return history_count() + 1;
+}
 
 /**
  * Prints the history
  */
 void print_history() {
-    /* This function should print history entries */
-    if(end < start)
-    {
-        for(int i = start; i < HIST_MAX; i++){
-            printf("%d %s" ,(int) h_ent[i].cmd_pos, h_ent[i].cmd_line);
+    uint64_t count = history_count();
+    
+    for(uint64_t seq = oldest_entry(count); seq < count; seq++){
+        char *line = entry_line(seq, count);
+        if(line != NULL){
+            printf("%d %s\n", (int) seq + 1, line);
         }
-        for(int i = 0; i <= end; i++){
-            printf("%d %s" , (int) h_ent[i].cmd_pos, h_ent[i].cmd_line);
+    }
+    fflush(stdout);
+}
+
+
+/**
+ * Finds the entry whose line starts at or before a position of the string
+ * space. Lines are written in entry order, so the records are sorted by
+ * str_off.
+ * @param pos - the position, counted like str_head
+ * @param lo - oldest entry (number - 1) it can be
+ * @param hi - one past the newest
+ * @return - the entry number - 1
+ */
+static uint64_t entry_at(uint64_t pos, uint64_t lo, uint64_t hi)
+{
+    while (hi - lo > 1) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (records[mid % hdr->capacity].str_off <= pos) {
+            lo = mid;
+        } else {
+            hi = mid;
         }
-          fflush(stdout);
     }
-    else
-    {
-        for(int i = 0; i < history_count; i++){
-              printf("%d %s" ,(int) h_ent[i].cmd_pos, h_ent[i].cmd_line);
-          }
-        LOGP("implemented.\n");
-        fflush(stdout);
+    return lo;
+}
+
+/**
+ * Finds the newest entries containing a pattern. The string space is
+ * scanned backwards with str_rfind, one lap of the ring at a time, and each
+ * hit is mapped to its entry; the rest of that line is then skipped.
+ * @param pattern - the substring to look for
+ * @param below - only entries numbered below this are searched
+ * @param found - filled with the entry numbers, newest first
+ * @param max - size of found
+ * @return - the number of entries found
+ */
+int history_search(const char *pattern, unsigned int below, unsigned int found[], int max)
+{
+    uint64_t count = history_count();
+    uint64_t lo = oldest_entry(count);
+    uint64_t hi = below > 0 && below - 1 < count ? below - 1 : count;
+    size_t k = strlen(pattern);
+    uint64_t start;
+    uint64_t end;
+    int n = 0;
+    
+    if (k == 0 || lo >= hi) {
+        return 0;
+    }
+    start = records[lo % hdr->capacity].str_off;
+    end = records[(hi - 1) % hdr->capacity].str_off + records[(hi - 1) % hdr->capacity].len;
+    
+    while (end > start && n < max) {
+        /* Lines never wrap, so [lap, end) is contiguous in the mapping */
+        uint64_t lap = (end - 1) - (end - 1) % hdr->str_cap;
+        const char *base;
+        const char *hit;
+        
+        if (lap < start) {
+            lap = start;
+        }
+        base = strings + lap % hdr->str_cap;
+        hit = str_rfind(base, end - lap, pattern, k);
+        if (hit == NULL) {
+            end = lap;
+        } else {
+            uint64_t pos = lap + (hit - base);
+            uint64_t seq = entry_at(pos, lo, hi);
+            const struct history_record *rec = &records[seq % hdr->capacity];
+            
+            if (pos + k <= rec->str_off + rec->len) {
+                found[n++] = seq + 1;
+                end = rec->str_off;
+                hi = seq;
+            } else {
+                end = pos + k - 1; // stale bytes skipped when a line did not fit
+            }
+        }
     }
+    return n;
 }
 
+/**
+ * The history builtin: "history" lists the history, "history -s pattern
+ * [count]" the newest entries (HIST_SEARCH_DEFAULT unless count is given)
+ * that contain pattern
+ * @param args - the command line
+ * @return - 0, 1 if nothing matched, 2 on a usage error
+ */
+int history_builtin(char *args[])
+{
+    unsigned int found[HIST_SEARCH_MAX];
+    int max = HIST_SEARCH_DEFAULT;
+    int n;
+    
+    if (args[1] == NULL) {
+        print_history();
+        return 0;
+    }
+    if (strcmp(args[1], "-s") != 0 || args[2] == NULL
+        || (args[3] != NULL && (max = atoi(args[3])) <= 0)) {
+        fprintf(stderr, "history: usage: history [-s pattern [count]]\n");
+        return 2;
+    }
+    if (max > HIST_SEARCH_MAX) {
+        max = HIST_SEARCH_MAX;
+    }
+    n = history_search(args[2], history_next(), found, max);
+    for (int i = n - 1; i >= 0; i--) {
+        printf("%u %s\n", found[i], findbyid(found[i]));
+    }
+    fflush(stdout);
+    return n > 0 ? 0 : 1;
+}
 
 /**
  *Checks if given string is empty
@@ -77,53 +415,52 @@ int is_empty(char *s) {
  */
 char* runlastcmnd(){
     // get the most recent cmmnd
-    char* last_cmmnd_ran = NULL;
-     if(end < start)
-        {
-          last_cmmnd_ran = h_ent[end-1].cmd_line;
-        }else{
-            last_cmmnd_ran = h_ent[history_count-1].cmd_line;
-        }
-    return last_cmmnd_ran;
-
-
+    uint64_t count = history_count();
+    
+    return count > 0 ? entry_line(count - 1, count) : NULL;
 }
 
 /**
- * Adds entry to array of history entry
- * @param cmd_pos - the id of the command
- * @param line - the line to add to the array
- * @return int - the length of the array
+ * Adds entry to the history: its line goes after the newest line in the
+ * string space (back at the start if it does not fit before the end), its
+ * record into the next index slot, then the count is bumped.
+ * @param line - the line to add (a trailing newline is dropped)
+ * @return - the number of the entry, or 0 if it was not added
  */
-int add_entry(unsigned int cmd_pos, char* line) {
-    if (is_empty(line) != 1) {
-
-    char* line_dup = strdup(line);
+unsigned int add_entry(char* line) {
+    size_t len = strcspn(line, "\n");
+    struct history_record *rec;
+    uint64_t off;
+    uint64_t seq;
     
-    if(end == HIST_MAX){ // if we are at the end then loop back and increment startm
-        end = end % HIST_MAX;
-        start++;
+    if (is_empty(line) == 1 || len >= HIST_LINE_MAX || len + 1 > hdr->str_cap / 4) {
+        return 0;
     }
-    if(history_count < HIST_MAX) { // if History is not full yet
-        h_ent[end+1].cmd_pos = cmd_pos;
-        h_ent[end+1].cmd_line = line_dup;
-        history_count++;
-        end++;
-        tempIndex++;
+    if (hist_fd != -1) {
+        flock(hist_fd, LOCK_EX);
     }
-    else if (history_count >= HIST_MAX) { // if history is already full
-//        start++;//move start
-        start = (start+1) % HIST_MAX; // keep under 100
-        end = (end+1) % HIST_MAX;
-//        end++;
-        tempIndex = history_count % HIST_MAX;
-        h_ent[end].cmd_pos = cmd_pos;
-        h_ent[end].cmd_line = line_dup;
-       }
-    return history_count;
+    
+    off = hdr->str_head;
+    if (off % hdr->str_cap + len + 1 > hdr->str_cap) {
+        off += hdr->str_cap - off % hdr->str_cap;
     }
-    return 0;
+    memcpy(strings + off % hdr->str_cap, line, len);
+    strings[off % hdr->str_cap + len] = '\0';
+    
+    seq = hdr->count;
+    rec = &records[seq % hdr->capacity];
+    rec->str_off = off;
+    rec->len = len;
+    hdr->str_head = off + len + 1;
+    __atomic_store_n(&hdr->count, seq + 1, __ATOMIC_RELEASE);
     
+    if (hist_fd != -1) {
+        flock(hist_fd, LOCK_UN);
+    }
+    if (index_ready) {
+        sync_index(history_count());
+    }
+    return seq + 1;
 }
 
 /**
@@ -141,36 +478,43 @@ int isNumeric (const char * s)
 }
 
 /**
- * Finds the given parameter by searching the history_entry array for string the starts with given parameter
+ * Finds the newest command that starts with the given prefix. Prefixes of
+ * up to HISTINDEX_DEPTH bytes are looked up in the prefix index; longer
+ * ones only check the entries that share their first HISTINDEX_DEPTH bytes.
  * @param arg1 - the string prefix to search for
  * @return - the whole command that was found
  */
 char* findbychar (char* arg1){
-    // iterate array and find cmmnd number
-   if(end < start)
-   {
-    for(int i = end; i >= 0; i--) { //from the end of the array
-       if(startswith(h_ent[i].cmd_line, arg1)){
-            return h_ent[i].cmd_line;
-       }
-    }
-    for(int i = HIST_MAX-1; i >= start; i--){
-        if(startswith(h_ent[i].cmd_line, arg1)){
-                return h_ent[i].cmd_line;
-            }
+    uint64_t count = history_count();
+    size_t len = strlen(arg1);
+    uint64_t seq;
+    
+    if(len == 0){
+        return runlastcmnd();
+    }
+    if(!index_ready){
+        if(histindex_init(hdr->capacity) == -1){
+            perror("history");
+            return NULL;
         }
-        return NULL;
+        index_ready = true;
+        index_lo = index_hi = 0;
     }
-   else
-   {
-        for(int i = history_count-1; i >= 0; i--){
-              if(startswith(arg1, h_ent[i].cmd_line)){
-                  return h_ent[i].cmd_line;
-              }
-          }
+    sync_index(count);
+    
+    if(!histindex_latest(arg1, len < HISTINDEX_DEPTH ? len : HISTINDEX_DEPTH, &seq)){
         return NULL;
-
     }
+    for(; seq != HISTINDEX_NONE && seq >= index_lo; seq = histindex_prev(seq)){
+        char *line = entry_line(seq, count);
+        if(line == NULL){
+            return NULL; // older lines were overwritten too
+        }
+        if(strncmp(line, arg1, len) == 0){
+            return line;
+        }
+    }
+    return NULL;
 }
 
 
@@ -210,39 +554,14 @@ bool startswith(const char *pre, const char *str)
 
 
 /**
- * Finds the command given a command number.
+ * Finds the command given a command number. Entry N sits in index record
+ * (N - 1) % capacity, so no search is needed.
  * @param cmndnum - the id to search for
  * @return the command found at given id
  */
 char* findbyid(int cmndnum) {
-    // iterate array and find cmmnd number
-//   int largestPos = largestPosition();
-   if(end < start)
-    {
-    for(int i = end; i >= 0; i--) { //from the end of the array
-       if(h_ent[i].cmd_pos == cmndnum){
-            return h_ent[i].cmd_line;
-       }
-    }
-    for(int i = HIST_MAX-1; i >= start; i--){
-        if(h_ent[i].cmd_pos == cmndnum){
-
-                return h_ent[i].cmd_line;
-            }
-        }
-       
-        return NULL;
-    }
-   else
-   {
-        for(int i = history_count-1; i >= 0; i--){
-              if(h_ent[i].cmd_pos == cmndnum){
-                  return h_ent[i].cmd_line;
-              }
-          }
+    if(cmndnum < 1){
         return NULL;
-
     }
+    return entry_line(cmndnum - 1, history_count());
 }
-
-
@@ -7,30 +7,71 @@
 #ifndef _HISTORY_H_
 #define _HISTORY_H_
 #include <stdbool.h>
+#include <stdint.h>
 
-#define HIST_MAX 100
+/**
+ * Number of entries kept when $CRASH_HISTSIZE is not set, and the most it
+ * may ask for
+ */
+#define HIST_DEFAULT_SIZE 10000
+#define HIST_MAX_SIZE (1UL << 24)
+
+/**
+ * Bytes of string space per entry; longer lines leave fewer entries
+ */
+#define HIST_AVG_LINE 64
 
+/**
+ * Longest line that is kept
+ */
+#define HIST_LINE_MAX 65536
 
-char* history[HIST_MAX];
 /**
- * Histort entry struct used to keep track of command id
+ * Entries "history -s" shows by default, and the most it will show
  */
-struct history_entry {
-    unsigned int cmd_pos;
-    char* cmd_line;
+#define HIST_SEARCH_DEFAULT 20
+#define HIST_SEARCH_MAX 1000
+
+#define HIST_MAGIC "CRASHHST"
+#define HIST_VERSION 1
+
+/**
+ * Start of the history file. It is followed by `capacity` index records
+ * (a ring, entry N is in record (N - 1) % capacity) and then by `str_cap`
+ * bytes of NUL terminated lines (also a ring; a line never wraps around).
+ */
+struct history_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t capacity;      // index records
+    uint64_t str_cap;       // bytes of string space
+    uint64_t count;         // entries ever added; entry numbers start at 1
+    uint64_t str_head;      // bytes ever written to the string space
+    uint64_t reserved[2];
 };
 
 /**
-*Finds the last position in the history array and returns
-* @return - the last position  in the history array
-*/
+ * Index record of one entry
+ */
+struct history_record {
+    uint64_t str_off;       // where the line was written, counted like str_head
+    uint32_t len;           // without the NUL
+    uint32_t reserved;
+};
+
+int history_open(const char *path, unsigned long capacity);
+void history_close();
+unsigned int history_next();
 char* runlastcmnd();
 char* bangFound(char* args[]);
 char* findbyid (int cmndnum);
 void print_history();
+int history_search(const char *pattern, unsigned int below, unsigned int found[], int max);
+int history_builtin(char *args[]);
 char* findbychar(char* arg1);
 bool startswith(const char *pre, const char *str);
-int add_entry(unsigned int cmd_pos, char* line);
+unsigned int add_entry(char* line);
 int is_empty(char *s);
 
 #endif
@@ -0,0 +1,685 @@
+/**
+* @file jobs.c
+* @author Ghufran Latif
+* @date 16 Oct. 2026
+* @Keeps track of every pipeline the shell launched. Children are reaped by
+ * a SIGCHLD handler that only calls waitpid and stores the status in the
+ * job table; the shell blocks SIGCHLD whenever it reads or changes the table
+ * and sleeps in sigsuspend while it waits for a job.
+*/
+#define _GNU_SOURCE
+#include "jobs.h"
+
+#include <stdio.h>
+
+#include "debug.h"
+#include "profile.h"
+
+#include <string.h>
+
+#include <stdlib.h>
+
+#include <errno.h>
+
+#include <signal.h>
+
+#include <termios.h>
+
+#include <unistd.h>
+
+#include <time.h>
+
+#include <sys/resource.h>
+
+#include <sys/wait.h>
+
+bool job_control = false;
+
+static struct job jobs[JOBS_MAX];
+static unsigned long job_seq = 0;
+
+static sigset_t chld_mask;      // just SIGCHLD
+static sigset_t stop_signals;   // reset to default in the children
+static pid_t shell_pgid;
+static struct termios shell_tmodes;
+
+/**
+ * Finds the process of a job with the given pid
+ * @param pid - process id
+ * @return - the process, or NULL if it is not part of any job
+ */
+static struct job_proc *find_proc(pid_t pid)
+{
+    if (pid <= 0) {
+        return NULL;
+    }
+    for (int i = 0; i < JOBS_MAX; i++) {
+        if (jobs[i].id == 0) {
+            continue;
+        }
+        for (int j = 0; j < jobs[i].nprocs; j++) {
+            if (jobs[i].procs[j].pid == pid) {
+                return &jobs[i].procs[j];
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Reaps every child that has changed state. Only async-signal-safe calls
+ * are made here: wait4, clock_gettime, and plain stores into the job table.
+ * @param signo - the signal number
+ */
+static void sigchld_handler(int signo)
+{
+    int saved_errno = errno;
+    struct job_proc *proc;
+    struct rusage usage;
+    pid_t pid;
+    int status;
+    
+    while ((pid = wait4(-1, &status, WNOHANG | WUNTRACED | WCONTINUED, &usage)) > 0) {
+        proc = find_proc(pid);
+        if (proc == NULL) {
+            continue;
+        }
+        if (WIFCONTINUED(status)) {
+            proc->stopped = false;
+            continue;
+        }
+        proc->status = status;
+        proc->stopped = WIFSTOPPED(status);
+        proc->done = !proc->stopped;
+        if (proc->done) {
+            proc->ended_ns = profile_now();
+            proc->user_us = usage.ru_utime.tv_sec * 1000000ULL + usage.ru_utime.tv_usec;
+            proc->sys_us = usage.ru_stime.tv_sec * 1000000ULL + usage.ru_stime.tv_usec;
+        }
+    }
+    errno = saved_errno;
+}
+
+/**
+ * Installs the SIGCHLD reaper and, for an interactive shell, puts the
+ * shell in its own process group in the foreground of the terminal
+ * @param interactive - true to enable job control
+ */
+void jobs_init(bool interactive)
+{
+    struct sigaction sa;
+    
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigchld_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGCHLD, &sa, NULL);
+    
+    sigemptyset(&chld_mask);
+    sigaddset(&chld_mask, SIGCHLD);
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGTSTP);
+    sigaddset(&stop_signals, SIGTTIN);
+    sigaddset(&stop_signals, SIGTTOU);
+    
+    job_control = interactive;
+    if (!job_control) {
+        return;
+    }
+    /* Wait until we are in the foreground (e.g. started with "crash &") */
+    while (tcgetpgrp(STDIN_FILENO) != (shell_pgid = getpgrp())) {
+        kill(-shell_pgid, SIGTTIN);
+    }
+    signal(SIGTSTP, SIG_IGN);
+    signal(SIGTTIN, SIG_IGN);
+    signal(SIGTTOU, SIG_IGN);
+    if (setpgid(0, 0) == 0) {
+        shell_pgid = getpid();
+    }
+    tcsetpgrp(STDIN_FILENO, shell_pgid);
+    tcgetattr(STDIN_FILENO, &shell_tmodes);
+    LOG("Job control enabled, shell process group %d\n", shell_pgid);
+}
+
+/**
+ * Keeps the SIGCHLD handler out of the job table
+ */
+void jobs_block()
+{
+    sigprocmask(SIG_BLOCK, &chld_mask, NULL);
+}
+
+/**
+ * Lets the SIGCHLD handler run again
+ */
+void jobs_unblock()
+{
+    sigprocmask(SIG_UNBLOCK, &chld_mask, NULL);
+}
+
+/**
+ * Sleeps until a signal (normally SIGCHLD) has been handled. SIGCHLD must
+ * be blocked, so a child that exits just before this call is not missed.
+ */
+static void wait_for_signal()
+{
+    sigset_t mask;
+    
+    sigprocmask(SIG_SETMASK, NULL, &mask);
+    sigdelset(&mask, SIGCHLD);
+    sigsuspend(&mask);
+}
+
+/**
+ * Exit code of a wait status, as used by $PIPESTATUS
+ * @param status - wait status
+ * @return - the exit code, or 128 + the signal number
+ */
+static int exit_code(int status)
+{
+    if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+    if (WIFSTOPPED(status)) {
+        return 128 + WSTOPSIG(status);
+    }
+    return WEXITSTATUS(status);
+}
+
+/**
+ * Works out the state of a job from the state of its processes
+ * @param job - the job
+ * @return - running while any process runs, else stopped while any is
+ *           stopped, else done
+ */
+static enum job_state job_state(const struct job *job)
+{
+    bool stopped = false;
+    
+    for (int i = 0; i < job->nprocs; i++) {
+        if (!job->procs[i].done && !job->procs[i].stopped) {
+            return JOB_RUNNING;
+        }
+        stopped |= job->procs[i].stopped;
+    }
+    return stopped ? JOB_STOPPED : JOB_DONE;
+}
+
+/**
+ * The current job: the one started or stopped most recently
+ * @return - the job, or NULL if there are none
+ */
+static struct job *current_job()
+{
+    struct job *cur = NULL;
+    
+    for (int i = 0; i < JOBS_MAX; i++) {
+        if (jobs[i].id != 0 && (cur == NULL || jobs[i].seq > cur->seq)) {
+            cur = &jobs[i];
+        }
+    }
+    return cur;
+}
+
+/**
+ * Prints a line of the jobs listing, e.g. "[1]+  Running   sleep 10 &"
+ * @param job - the job
+ * @param state - its state
+ */
+static void print_job(struct job *job, enum job_state state)
+{
+    int status = job->procs[job->nprocs - 1].status;
+    char what[32];
+    
+    if (state == JOB_RUNNING) {
+        strcpy(what, "Running");
+    } else if (state == JOB_STOPPED) {
+        strcpy(what, "Stopped");
+    } else if (WIFSIGNALED(status)) {
+        snprintf(what, sizeof(what), "%s", strsignal(WTERMSIG(status)));
+    } else if (WEXITSTATUS(status) != 0) {
+        snprintf(what, sizeof(what), "Exit %d", WEXITSTATUS(status));
+    } else {
+        strcpy(what, "Done");
+    }
+    printf("[%d]%c  %-22s %s%s\n", job->id, job == current_job() ? '+' : ' ',
+           what, job->text, state == JOB_RUNNING && job->background ? " &" : "");
+}
+
+/**
+ * Empties the slot of a job, after recording it in $CRASH_PROFILE
+ * @param job - the job
+ */
+static void job_free(struct job *job)
+{
+    profile_job(job);
+    job->id = 0;
+    job->nprocs = 0;
+}
+
+/**
+ * Takes a slot for a new job. SIGCHLD must be blocked. When the table is
+ * full, a finished job nobody waited for (and no caller holds) is dropped
+ * to make room.
+ * @param text - command text for the jobs listing
+ * @return - the job, or NULL if every slot holds a live job
+ */
+struct job *job_new(const char *text)
+{
+    struct job *job = NULL;
+    
+    for (int i = 0; i < JOBS_MAX && job == NULL; i++) {
+        if (jobs[i].id == 0) {
+            job = &jobs[i];
+        }
+    }
+    for (int i = 0; i < JOBS_MAX && job == NULL; i++) {
+        if (!jobs[i].held && job_state(&jobs[i]) == JOB_DONE) {
+            job = &jobs[i];
+            job_free(job);
+        }
+    }
+    if (job == NULL) {
+        fprintf(stderr, "crash: too many jobs\n");
+        return NULL;
+    }
+    
+    job->id = job - jobs + 1;
+    job->pgid = 0;
+    job->background = false;
+    job->held = false;
+    job->reported = JOB_RUNNING;
+    job->seq = ++job_seq;
+    job->nprocs = 0;
+    snprintf(job->text, sizeof(job->text), "%s", text);
+    return job;
+}
+
+/**
+ * Adds the process of the next stage to a job. SIGCHLD must be blocked
+ * from before the launch until here, so the reaper cannot miss it.
+ * @param job - the job
+ * @param pid - pid of the stage, or -1 if it could not be launched
+ * @param status - wait status to report for a stage that was not launched
+ * @param name - the command, for the time builtin and the profile
+ * @param started - profile_now() from before the stage was launched
+ */
+void job_add_proc(struct job *job, pid_t pid, int status, const char *name, uint64_t started)
+{
+    struct job_proc *proc = &job->procs[job->nprocs++];
+    
+    proc->pid = pid;
+    proc->status = status;
+    proc->done = pid == -1;
+    proc->stopped = false;
+    snprintf(proc->name, sizeof(proc->name), "%s", name);
+    proc->started_ns = started;
+    proc->launched_ns = profile_now();
+    proc->ended_ns = proc->launched_ns;
+    proc->user_us = 0;
+    proc->sys_us = 0;
+    if (pid != -1 && job->pgid == 0 && job_control) {
+        job->pgid = pid;
+    }
+}
+
+/**
+ * Sends SIGCONT to every process of a job
+ * @param job - the job
+ */
+static void continue_job(struct job *job)
+{
+    for (int i = 0; i < job->nprocs; i++) {
+        job->procs[i].stopped = false;
+    }
+    if (job->pgid > 0) {
+        kill(-job->pgid, SIGCONT);
+        return;
+    }
+    for (int i = 0; i < job->nprocs; i++) {
+        if (!job->procs[i].done) {
+            kill(job->procs[i].pid, SIGCONT);
+        }
+    }
+}
+
+/**
+ * Runs a job in the foreground: hands it the terminal and waits until every
+ * process has finished or one was stopped, then fills in pipestatus. A
+ * finished job leaves the table. SIGCHLD must be blocked.
+ * @param job - the job
+ * @param cont - true to send SIGCONT first (fg)
+ * @return - wait status of the last stage
+ */
+int job_foreground(struct job *job, bool cont)
+{
+    enum job_state state;
+    int status;
+    
+    job->background = false;
+    if (job_control && job->pgid > 0) {
+        tcsetpgrp(STDIN_FILENO, job->pgid);
+    }
+    if (cont) {
+        continue_job(job);
+    }
+    while ((state = job_state(job)) == JOB_RUNNING) {
+        wait_for_signal();
+    }
+    if (job_control) {
+        tcsetpgrp(STDIN_FILENO, shell_pgid);
+        tcsetattr(STDIN_FILENO, TCSADRAIN, &shell_tmodes);
+    }
+    
+    pipestatus_count = job->nprocs;
+    for (int i = 0; i < job->nprocs; i++) {
+        pipestatus[i] = exit_code(job->procs[i].status);
+    }
+    status = job->procs[job->nprocs - 1].status;
+    LOG("Job of %d stage(s) finished, last status %d\n", job->nprocs, pipestatus[job->nprocs - 1]);
+    
+    if (state == JOB_STOPPED) {
+        job->seq = ++job_seq;
+        job->reported = JOB_STOPPED;
+        printf("\n");
+        print_job(job, state);
+        return status;
+    }
+    if (job_control && WIFSIGNALED(status) && WTERMSIG(status) == SIGINT) {
+        printf("\n");
+    }
+    job_free(job);
+    return status;
+}
+
+/**
+ * Leaves a freshly launched job running in the background
+ * @param job - the job
+ */
+void job_background(struct job *job)
+{
+    job->background = true;
+    if (job_control) {
+        printf("[%d] %d\n", job->id, job->procs[job->nprocs - 1].pid);
+    }
+}
+
+/**
+ * Tells whether every process of a job has finished. SIGCHLD must be
+ * blocked.
+ * @param job - the job
+ * @return - true once the job is done
+ */
+bool job_finished(struct job *job)
+{
+    return job_state(job) == JOB_DONE;
+}
+
+/**
+ * Removes a finished job from the table. SIGCHLD must be blocked.
+ * @param job - the job
+ * @return - wait status of its last stage
+ */
+int job_release(struct job *job)
+{
+    int status = job->procs[job->nprocs - 1].status;
+    
+    job_free(job);
+    return status;
+}
+
+/**
+ * Sleeps until the SIGCHLD handler (or another one) has run, for callers
+ * that keep SIGCHLD blocked while they wait on several jobs at once
+ */
+void jobs_suspend()
+{
+    wait_for_signal();
+}
+
+/**
+ * Tells the user about background jobs that finished or stopped since the
+ * last prompt. Without job control nothing is printed and finished jobs stay
+ * in the table until wait collects them.
+ */
+void jobs_notify()
+{
+    if (!job_control) {
+        return;
+    }
+    jobs_block();
+    for (int i = 0; i < JOBS_MAX; i++) {
+        enum job_state state;
+    
+        if (jobs[i].id == 0) {
+            continue;
+        }
+        state = job_state(&jobs[i]);
+        if (state == jobs[i].reported) {
+            continue;
+        }
+        print_job(&jobs[i], state);
+        jobs[i].reported = state;
+        if (state == JOB_DONE) {
+            job_free(&jobs[i]);
+        }
+    }
+    jobs_unblock();
+}
+
+/**
+ * Sets up posix_spawn so the child starts with no signals blocked and, with
+ * job control, in the given process group with default ^Z handling
+ * @param attr - initialized spawn attributes
+ * @param pgid - process group to join (0 for a new one), or -1 for none
+ */
+void job_spawnattr(posix_spawnattr_t *attr, pid_t pgid)
+{
+    short flags = POSIX_SPAWN_SETSIGMASK;
+    sigset_t none;
+    
+    sigemptyset(&none);
+    posix_spawnattr_setsigmask(attr, &none);
+    if (pgid != -1) {
+        posix_spawnattr_setpgroup(attr, pgid);
+        posix_spawnattr_setsigdefault(attr, &stop_signals);
+        flags |= POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGDEF;
+    }
+    posix_spawnattr_setflags(attr, flags);
+}
+
+/**
+ * Does in a forked child what job_spawnattr asks posix_spawn to do. A child
+ * that does not exec (a builtin stage, a background and-or list) also
+ * drops the shell's SIGINT and SIGTERM handlers, so ^C stops it.
+ * @param pgid - process group to join (0 for a new one), or -1 for none
+ */
+void job_child(pid_t pgid)
+{
+    sigset_t none;
+    
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    if (pgid != -1) {
+        setpgid(0, pgid);
+        signal(SIGTSTP, SIG_DFL);
+        signal(SIGTTIN, SIG_DFL);
+        signal(SIGTTOU, SIG_DFL);
+    }
+    sigemptyset(&none);
+    sigprocmask(SIG_SETMASK, &none, NULL);
+}
+
+/**
+ * Finds a job from a job spec: "%N" or "N" for job N, nothing, "%%" or "%+"
+ * for the current job. SIGCHLD must be blocked.
+ * @param spec - the job spec, or NULL
+ * @param builtin - name of the builtin, for the error message
+ * @return - the job, or NULL
+ */
+static struct job *find_job(const char *spec, const char *builtin)
+{
+    struct job *job = NULL;
+    
+    if (spec == NULL || strcmp(spec, "%%") == 0 || strcmp(spec, "%+") == 0) {
+        job = current_job();
+        if (job == NULL) {
+            fprintf(stderr, "crash: %s: no current job\n", builtin);
+        }
+        return job;
+    }
+    
+    int id = atoi(spec[0] == '%' ? spec + 1 : spec);
+    if (id >= 1 && id <= JOBS_MAX && jobs[id - 1].id != 0) {
+        job = &jobs[id - 1];
+    }
+    if (job == NULL) {
+        fprintf(stderr, "crash: %s: %s: no such job\n", builtin, spec);
+    }
+    return job;
+}
+
+/**
+ * The jobs builtin: lists every job, then forgets the finished ones
+ * @param args - the arguments (unused)
+ * @return - exit status
+ */
+int jobs_builtin(char *args[])
+{
+    jobs_block();
+    for (int i = 0; i < JOBS_MAX; i++) {
+        enum job_state state;
+    
+        if (jobs[i].id == 0) {
+            continue;
+        }
+        state = job_state(&jobs[i]);
+        print_job(&jobs[i], state);
+        jobs[i].reported = state;
+        if (state == JOB_DONE) {
+            job_free(&jobs[i]);
+        }
+    }
+    jobs_unblock();
+    return 0;
+}
+
+/**
+ * The fg builtin: continues a job in the foreground and waits for it
+ * @param args - args[1] is the job spec, the current job if missing
+ * @return - exit status of the job
+ */
+int fg_builtin(char *args[])
+{
+    struct job *job;
+    int status;
+    
+    jobs_block();
+    job = find_job(args[1], "fg");
+    if (job == NULL) {
+        jobs_unblock();
+        return 1;
+    }
+    printf("%s\n", job->text);
+    fflush(stdout);
+    status = job_foreground(job, true);
+    jobs_unblock();
+    return exit_code(status);
+}
+
+/**
+ * The bg builtin: continues a stopped job in the background
+ * @param args - args[1] is the job spec, the current job if missing
+ * @return - exit status
+ */
+int bg_builtin(char *args[])
+{
+    struct job *job;
+    
+    jobs_block();
+    job = find_job(args[1], "bg");
+    if (job == NULL) {
+        jobs_unblock();
+        return 1;
+    }
+    if (job_state(job) != JOB_STOPPED) {
+        fprintf(stderr, "crash: bg: job %d already in background\n", job->id);
+        jobs_unblock();
+        return 0;
+    }
+    job->background = true;
+    job->reported = JOB_RUNNING;
+    continue_job(job);
+    printf("[%d]  %s &\n", job->id, job->text);
+    jobs_unblock();
+    return 0;
+}
+
+/**
+ * The wait builtin. Without arguments, waits for every running job. With
+ * arguments ("%N" job specs or process ids), waits for each of them in turn.
+ * Jobs that are waited for to completion leave the table silently.
+ * @param args - the arguments
+ * @return - exit status of the last job or process waited for, 127 if it
+ *           is unknown
+ */
+int wait_builtin(char *args[])
+{
+    int rv = 0;
+    
+    jobs_block();
+    if (args[1] == NULL) {
+        for (int i = 0; i < JOBS_MAX; i++) {
+            if (jobs[i].id == 0) {
+                continue;
+            }
+            while (job_state(&jobs[i]) == JOB_RUNNING) {
+                wait_for_signal();
+            }
+            if (job_state(&jobs[i]) == JOB_DONE) {
+                job_free(&jobs[i]);
+            }
+        }
+        jobs_unblock();
+        return 0;
+    }
+    
+    for (int i = 1; args[i] != NULL; i++) {
+        struct job_proc *proc;
+        struct job *job;
+    
+        if (args[i][0] == '%') {
+            job = find_job(args[i], "wait");
+            if (job == NULL) {
+                rv = 127;
+                continue;
+            }
+            proc = &job->procs[job->nprocs - 1];
+            while (job_state(job) == JOB_RUNNING) {
+                wait_for_signal();
+            }
+        } else {
+            proc = find_proc(atoi(args[i]));
+            if (proc == NULL) {
+                fprintf(stderr, "crash: wait: pid %s is not a child of this shell\n", args[i]);
+                rv = 127;
+                continue;
+            }
+            job = NULL;
+            for (int j = 0; j < JOBS_MAX && job == NULL; j++) {
+                if (proc >= jobs[j].procs && proc < jobs[j].procs + jobs[j].nprocs) {
+                    job = &jobs[j];
+                }
+            }
+            while (!proc->done && !proc->stopped) {
+                wait_for_signal();
+            }
+        }
+        rv = exit_code(proc->status);
+        if (job_state(job) == JOB_DONE) {
+            job_free(job);
+        }
+    }
+    jobs_unblock();
+    return rv;
+}
@@ -0,0 +1,97 @@
+/**
+* @file jobs.h
+* @author Ghufran Latif
+* @date 16 Oct. 2026
+* @Header file for jobs.c, the job table, the SIGCHLD reaper and the
+ * jobs, fg, bg and wait builtins
+*/
+#ifndef _JOBS_H_
+#define _JOBS_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <spawn.h>
+#include <sys/types.h>
+
+#include "pipeline.h"
+
+/**
+ * Most jobs (foreground, background or stopped) at once
+ */
+#define JOBS_MAX 64
+
+/**
+ * Longest command text kept for the jobs listing
+ */
+#define JOB_TEXT_MAX 256
+
+/**
+ * Longest command name kept for each process, for the time builtin
+ */
+#define JOB_NAME_MAX 24
+
+enum job_state {
+    JOB_RUNNING,
+    JOB_STOPPED,
+    JOB_DONE,
+};
+
+/**
+ * One process of a job. Written by the SIGCHLD handler, so the rest of the
+ * shell only looks at it with SIGCHLD blocked.
+ */
+struct job_proc {
+    pid_t pid;          // -1 if the stage could not be launched
+    int status;         // last wait status: exit, signal or stop
+    bool done;
+    bool stopped;
+    char name[JOB_NAME_MAX];    // argv[0] of the stage
+    uint64_t started_ns;        // profile_now() when its launch began
+    uint64_t launched_ns;       // ... when posix_spawn (or fork) returned
+    uint64_t ended_ns;          // ... when it was reaped
+    uint64_t user_us;           // CPU time, from wait4
+    uint64_t sys_us;
+};
+
+/**
+ * A pipeline launched by the shell, with one process per stage
+ */
+struct job {
+    int id;                         // 0 marks a free slot
+    pid_t pgid;                     // process group, 0 without job control
+    bool background;
+    bool held;                      // owned by a caller until job_release
+    enum job_state reported;        // state the user was last told about
+    unsigned long seq;              // the highest is the current job
+    int nprocs;
+    struct job_proc procs[PIPELINE_MAX];
+    char text[JOB_TEXT_MAX];
+};
+
+/**
+ * True when the shell reads commands from a terminal: jobs get their own
+ * process group and can be stopped with ^Z and moved with fg and bg
+ */
+extern bool job_control;
+
+void jobs_init(bool interactive);
+void jobs_block();
+void jobs_unblock();
+void jobs_notify();
+
+struct job *job_new(const char *text);
+void job_add_proc(struct job *job, pid_t pid, int status, const char *name, uint64_t started);
+int job_foreground(struct job *job, bool cont);
+void job_background(struct job *job);
+bool job_finished(struct job *job);
+int job_release(struct job *job);
+void jobs_suspend();
+void job_spawnattr(posix_spawnattr_t *attr, pid_t pgid);
+void job_child(pid_t pgid);
+
+int jobs_builtin(char *args[]);
+int fg_builtin(char *args[]);
+int bg_builtin(char *args[]);
+int wait_builtin(char *args[]);
+
+#endif
@@ -0,0 +1,113 @@
+/**
+* @file lexbench.c
+* @author Ghufran Latif
+* @date 16 Oct. 2026
+* @Lexer microbenchmark: tokenizes a large generated script with the old
+ * strspn/strcspn tokenizer and with lex_line, and prints MB/s for each.
+ * Usage: ./lexbench [lines]
+*/
+#include <stdio.h>
+
+#include <string.h>
+
+#include <stdlib.h>
+
+#include <time.h>
+
+#include "arena.h"
+#include "tokenizer.h"
+
+#define TOKENS_MAX 4096
+
+/* Line shapes found in our batch scripts */
+static const char *templates[] = {
+    "cat /var/log/app/%d.log | grep -v DEBUG | wc -l\n",
+    "cp /srv/data/input-%d.csv /srv/data/archive/input-%d.csv.bak\n",
+    "echo processing item %d of the nightly batch > /tmp/status\n",
+    "sort -k 2 -n /tmp/chunk.%d | uniq -c | head -n 20\n",
+    "/usr/local/bin/ship --host node%d.example.com --retries 3 --quiet\n",
+};
+
+/**
+ * The tokenizer this file replaced: copy the line, then split it on
+ * whitespace with next_token. Returns the number of tokens.
+ */
+static int old_tokenize(char *args[], const char *line)
+{
+    char *line_ptr = strdup(line);
+    char *next_tok = line_ptr;
+    char *curr_tok;
+    int tokens = 0;
+    
+    while ((curr_tok = next_token(&next_tok, " \t\n\r")) != NULL && tokens < TOKENS_MAX - 1) {
+        if (strstr(curr_tok, "#") != NULL) {
+            break;
+        }
+        args[tokens++] = curr_tok;
+    }
+    args[tokens] = NULL;
+    free(line_ptr);
+    return tokens;
+}
+
+/**
+ * Seconds on the monotonic clock
+ */
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+    int lines = argc > 1 ? atoi(argv[1]) : 200000;
+    size_t ntemplates = sizeof(templates) / sizeof(templates[0]);
+    char **script = malloc(lines * sizeof(char *));
+    size_t bytes = 0;
+    static char *args[TOKENS_MAX];
+    static struct token toks[TOKENS_MAX];
+    struct arena arena;
+    long total = 0;
+    double start, old_s, new_s;
+    
+    if (script == NULL) {
+        perror("malloc");
+        return 1;
+    }
+    for (int i = 0; i < lines; i++) {
+        char buf[256];
+        snprintf(buf, sizeof(buf), templates[i % ntemplates], i, i);
+        script[i] = strdup(buf);
+        bytes += strlen(buf);
+    }
+    
+    start = now();
+    for (int i = 0; i < lines; i++) {
+        total += old_tokenize(args, script[i]);
+    }
+    old_s = now() - start;
+    
+    arena_init(&arena, ARENA_CHUNK_SZ);
+    start = now();
+    for (int i = 0; i < lines; i++) {
+        arena_reset(&arena);
+        total -= lex_line(toks, TOKENS_MAX, script[i], &arena);
+    }
+    new_s = now() - start;
+    
+    printf("%d lines, %.1f MB\n", lines, bytes / 1e6);
+    printf("strspn/strcspn: %7.3f s  %7.1f MB/s\n", old_s, bytes / 1e6 / old_s);
+    printf("lex_line:       %7.3f s  %7.1f MB/s\n", new_s, bytes / 1e6 / new_s);
+    if (total != 0) {
+        printf("warning: token counts differ by %ld\n", total);
+    }
+    
+    arena_free(&arena);
+    for (int i = 0; i < lines; i++) {
+        free(script[i]);
+    }
+    free(script);
+    return 0;
+}
@@ -0,0 +1,324 @@
+/**
+* @file lineedit.c
+* @author Ghufran Latif
+* @date 16 Oct. 2026
+* @Reads a command line from the terminal. The terminal is taken out of
+ * canonical mode while the line is typed, so keys like Ctrl-R reach the
+ * shell; the editing the terminal used to do (erase, kill line, erase
+ * word) is done here instead. Ctrl-R searches the history backwards for
+ * the text typed after it, like bash.
+*/
+#include "lineedit.h"
+
+#include <stdio.h>
+
+#include "debug.h"
+#include "history.h"
+
+#include <string.h>
+
+#include <stdlib.h>
+
+#include <stdbool.h>
+
+#include <errno.h>
+
+#include <termios.h>
+
+#include <unistd.h>
+
+#ifndef CTRL
+#define CTRL(c) ((c) & 0x1f)
+#endif
+#define KEY_ESC 27
+#define KEY_DEL 127
+
+/**
+ * The line being typed
+ */
+struct edit {
+    char **line;
+    size_t *sz;
+    size_t len;
+    void (*prompt)();
+};
+
+/**
+ * Writes to the terminal
+ * @param s - bytes to write
+ * @param n - number of bytes
+ */
+static void put(const char *s, size_t n)
+{
+    while (n > 0) {
+        ssize_t w = write(STDOUT_FILENO, s, n);
+        if (w == -1 && errno == EINTR) {
+            continue;
+        }
+        if (w <= 0) {
+            return;
+        }
+        s += w;
+        n -= w;
+    }
+}
+
+/**
+ * Reads one byte from the terminal
+ * @return - the byte, or -1 at the end of input
+ */
+static int get_key()
+{
+    unsigned char c;
+    ssize_t r;
+    
+    while ((r = read(STDIN_FILENO, &c, 1)) == -1 && errno == EINTR) {
+    }
+    return r == 1 ? c : -1;
+}
+
+/**
+ * Skips the rest of an escape sequence (arrow keys and the like)
+ */
+static void skip_escape()
+{
+    int c = get_key();
+    
+    if (c == '[' || c == 'O') {
+        do {
+            c = get_key();
+        } while (c != -1 && (c < 0x40 || c > 0x7e));
+    }
+}
+
+/**
+ * Makes room in the line
+ * @param e - the line
+ * @param extra - bytes to add, not counting the NUL
+ * @return - 0, or -1 if out of memory
+ */
+static int reserve(struct edit *e, size_t extra)
+{
+    if (e->len + extra + 2 > *e->sz) {
+        size_t sz = (e->len + extra + 2) * 2;
+        char *p = realloc(*e->line, sz);
+        if (p == NULL) {
+            perror("realloc");
+            return -1;
+        }
+        *e->line = p;
+        *e->sz = sz;
+    }
+    return 0;
+}
+
+/**
+ * Replaces the line
+ * @param e - the line
+ * @param text - its new text
+ */
+static void set_line(struct edit *e, const char *text)
+{
+    size_t len = strlen(text);
+    
+    e->len = 0;
+    if (reserve(e, len) == 0) {
+        memcpy(*e->line, text, len);
+        e->len = len;
+    }
+}
+
+/**
+ * Draws the prompt and the line again over the current terminal line
+ * @param e - the line
+ */
+static void redraw(struct edit *e)
+{
+    put("\r\033[K", 4);
+    e->prompt();
+    put(*e->line, e->len);
+}
+
+/**
+ * Removes the last character, with its UTF-8 continuation bytes
+ * @param e - the line
+ * @return - true if there was one
+ */
+static bool erase_char(struct edit *e)
+{
+    if (e->len == 0) {
+        return false;
+    }
+    while (e->len > 0 && ((*e->line)[e->len - 1] & 0xc0) == 0x80) {
+        e->len--;
+    }
+    if (e->len > 0) {
+        e->len--;
+    }
+    return true;
+}
+
+/**
+ * Draws the reverse search line
+ * @param pattern - what is searched for
+ * @param match - the line found, or NULL
+ * @param failed - true if the last search found nothing
+ */
+static void draw_search(const char *pattern, const char *match, bool failed)
+{
+    put("\r\033[K", 4);
+    if (failed) {
+        put("(failed reverse-i-search)`", 26);
+    } else {
+        put("(reverse-i-search)`", 19);
+    }
+    put(pattern, strlen(pattern));
+    put("': ", 3);
+    if (match != NULL) {
+        put(match, strlen(match));
+    }
+}
+
+/**
+ * Ctrl-R: searches the history for the newest entry containing what is
+ * typed next. Ctrl-R again finds the next older one, Enter runs the entry,
+ * Ctrl-G or Ctrl-C gives up and any other key keeps the entry for editing.
+ * @param e - the line, replaced by the entry found
+ * @return - true if the line should run now
+ */
+static bool reverse_search(struct edit *e)
+{
+    char pattern[LINEEDIT_SEARCH_MAX] = "";
+    size_t plen = 0;
+    unsigned int match = 0;
+    const char *found = NULL;
+    bool failed = false;
+    int c;
+    
+    draw_search(pattern, found, failed);
+    while ((c = get_key()) != -1) {
+        unsigned int below = history_next();
+        unsigned int num;
+        
+        if (c == '\n' || c == '\r') {
+            if (found != NULL) {
+                set_line(e, found);
+            }
+            redraw(e);
+            return true;
+        }
+        if (c == CTRL('g') || c == CTRL('c')) {
+            break;
+        }
+        if (c == CTRL('r')) {
+            below = match != 0 ? match : below;
+        } else if (c == KEY_DEL || c == CTRL('h')) {
+            while (plen > 0 && (pattern[plen - 1] & 0xc0) == 0x80) {
+                plen--;
+            }
+            if (plen > 0) {
+                plen--;
+            }
+            pattern[plen] = '\0';
+        } else if ((unsigned char) c >= ' ' && plen + 1 < sizeof(pattern)) {
+            pattern[plen++] = c;
+            pattern[plen] = '\0';
+            below = match != 0 ? match + 1 : below; // the match may still fit
+        } else {
+            if (c == KEY_ESC) {
+                skip_escape();
+            }
+            if (found != NULL) {
+                set_line(e, found);
+            }
+            break;
+        }
+        
+        /* Keep the last match while the pattern is only partly typed */
+        failed = plen > 0 && history_search(pattern, below, &num, 1) == 0;
+        if (plen > 0 && !failed) {
+            match = num;
+            found = findbyid(num);
+        }
+        draw_search(pattern, found, failed);
+    }
+    redraw(e);
+    return false;
+}
+
+/**
+ * Reads a line from the terminal, like getline. The prompt has already been
+ * printed; it is printed again when the line has to be redrawn.
+ * @param line - buffer, grown as needed
+ * @param sz - its size
+ * @param prompt - prints the prompt
+ * @return - length of the line, ending in a newline, or -1 at the end of
+ *           input
+ */
+ssize_t lineedit_read(char **line, size_t *sz, void (*prompt)())
+{
+    struct edit e = { line, sz, 0, prompt };
+    struct termios saved;
+    struct termios raw;
+    ssize_t rv = -1;
+    int c;
+    
+    if (tcgetattr(STDIN_FILENO, &saved) == -1) {
+        return getline(line, sz, stdin);
+    }
+    raw = saved;
+    raw.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSADRAIN, &raw) == -1) {
+        return getline(line, sz, stdin);
+    }
+    if (reserve(&e, 0) == -1) {
+        tcsetattr(STDIN_FILENO, TCSADRAIN, &saved);
+        return -1;
+    }
+    
+    while ((c = get_key()) != -1) {
+        if (c == '\n' || c == '\r' || (c == CTRL('r') && reverse_search(&e))) {
+            put("\n", 1);
+            (*line)[e.len++] = '\n';
+            (*line)[e.len] = '\0';
+            rv = e.len;
+            break;
+        }
+        if (c == CTRL('d') && e.len == 0) {
+            put("\n", 1);
+            break;
+        }
+        if (c == CTRL('c')) {
+            put("^C\n", 3);
+            e.len = 0;
+            prompt();
+        } else if (c == KEY_DEL || c == CTRL('h')) {
+            if (erase_char(&e)) {
+                put("\b \b", 3);
+            }
+        } else if (c == CTRL('u')) {
+            e.len = 0;
+            redraw(&e);
+        } else if (c == CTRL('w')) {
+            while (e.len > 0 && (*line)[e.len - 1] == ' ') {
+                e.len--;
+            }
+            while (e.len > 0 && (*line)[e.len - 1] != ' ') {
+                e.len--;
+            }
+            redraw(&e);
+        } else if (c == KEY_ESC) {
+            skip_escape();
+        } else if (c >= ' ' || c == '\t') {
+            if (reserve(&e, 1) == 0) {
+                (*line)[e.len++] = c;
+                put(*line + e.len - 1, 1);
+            }
+        }
+    }
+    
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &saved);
+    return rv;
+}
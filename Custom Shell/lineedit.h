@@ -0,0 +1,19 @@
+/**
+* @file lineedit.h
+* @author Ghufran Latif
+* @date 16 Oct. 2026
+* @Header file for lineedit.c, which reads lines from the terminal
+*/
+#ifndef _LINEEDIT_H_
+#define _LINEEDIT_H_
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * Longest pattern of a reverse search
+ */
+#define LINEEDIT_SEARCH_MAX 256
+
+ssize_t lineedit_read(char **line, size_t *sz, void (*prompt)());
+
+#endif
@@ -0,0 +1,325 @@
+/**
+* @file parallel.c
+* @author Ghufran Latif
+* @date 16 Oct. 2026
+* @The parallel builtin: runs a command once per item, at most N at a time,
+ * like "xargs -P". Every run goes through parseargs and launch_pipeline like
+ * any other command line. Its output is collected in a memfd and written out
+ * in one piece when it finishes, so the output of different runs never
+ * interleaves.
+*/
+#define _GNU_SOURCE
+#include "parallel.h"
+
+#include <stdio.h>
+
+#include "arena.h"
+#include "debug.h"
+#include "pipeline.h"
+#include "tokenizer.h"
+
+#include <string.h>
+
+#include <stdlib.h>
+
+#include <stdbool.h>
+
+#include <fcntl.h>
+
+#include <unistd.h>
+
+#include <signal.h>
+
+#include <sys/mman.h>
+
+#include <sys/wait.h>
+
+/**
+ * Where the items come from: the words after ":::", or lines of a file
+ * (stdin unless the line ends with "< file")
+ */
+struct item_source {
+    struct token *toks;     // words after ":::", NULL to read `in`
+    int ntok;
+    int next;
+    FILE *in;
+    char *line;             // getline buffer
+    size_t line_sz;
+};
+
+/**
+ * Hands out the next item
+ * @param src - the item source
+ * @return - the item, or NULL when there are no more
+ */
+static const char *next_item(struct item_source *src)
+{
+    ssize_t len;
+    
+    if (src->toks != NULL) {
+        return src->next < src->ntok ? src->toks[src->next++].text : NULL;
+    }
+    while ((len = getline(&src->line, &src->line_sz, src->in)) != -1) {
+        if (len > 0 && src->line[len - 1] == '\n') {
+            src->line[--len] = '\0';
+        }
+        if (len > 0) {
+            return src->line;
+        }
+    }
+    clearerr(src->in); // ^D ends the items, not the shell
+    return NULL;
+}
+
+/**
+ * Replaces every "{}" of a word with the item
+ * @param word - the word of the command template
+ * @param item - the item
+ * @param arena - arena the result is allocated from
+ * @return - the new word, or NULL if out of memory
+ */
+static char *fill_braces(const char *word, const char *item, struct arena *arena)
+{
+    size_t item_len = strlen(item);
+    size_t len = strlen(word);
+    const char *p;
+    char *out;
+    char *q;
+    
+    for (p = strstr(word, "{}"); p != NULL; p = strstr(p + 2, "{}")) {
+        len += item_len - 2;
+    }
+    out = arena_alloc(arena, len + 1);
+    if (out == NULL) {
+        return NULL;
+    }
+    q = out;
+    while ((p = strstr(word, "{}")) != NULL) {
+        memcpy(q, word, p - word);
+        q += p - word;
+        memcpy(q, item, item_len);
+        q += item_len;
+        word = p + 2;
+    }
+    strcpy(q, word);
+    return out;
+}
+
+/**
+ * Launches the command template for one item. Every "{}" is replaced with
+ * the item; if there is none, the item is added as the last argument.
+ * @param tmpl - tokens of the command template
+ * @param ntmpl - number of tokens
+ * @param item - the item
+ * @param arena - scratch arena for this run
+ * @param in_fd - stdin of the run
+ * @param out_fd - stdout of the run
+ * @param job - set to the job, NULL if it could not be started
+ * @return - 0, or -1 on a syntax error
+ */
+static int launch_item(struct token *tmpl, int ntmpl, const char *item, struct arena *arena,
+                       int in_fd, int out_fd, struct job **job)
+{
+    struct token *toks = arena_alloc(arena, (ntmpl + 1) * sizeof(struct token));
+    bool filled = false;
+    int n = 0;
+    
+    if (toks == NULL) {
+        *job = NULL;
+        return 0;
+    }
+    for (; n < ntmpl; n++) {
+        toks[n] = tmpl[n];
+        if (tmpl[n].type == TOKEN_WORD && strstr(tmpl[n].text, "{}") != NULL) {
+            toks[n].text = fill_braces(tmpl[n].text, item, arena);
+            filled = true;
+        }
+    }
+    if (!filled) {
+        toks[n].type = TOKEN_WORD;
+        toks[n].op = OP_NONE;
+        toks[n].start = item;
+        toks[n].len = strlen(item);
+        toks[n].text = arena_strdup(arena, item);
+        n++;
+    }
+    return launch_tokens(toks, n, arena, in_fd, out_fd, job);
+}
+
+/**
+ * Writes out (and empties) the output a run collected
+ * @param fd - the memfd of the run
+ */
+static void flush_output(int fd)
+{
+    char buf[65536];
+    off_t off = 0;
+    ssize_t n;
+    
+    while ((n = pread(fd, buf, sizeof(buf), off)) > 0) {
+        for (ssize_t done = 0; done < n; ) {
+            ssize_t w = write(STDOUT_FILENO, buf + done, n - done);
+            if (w == -1) {
+                perror("write");
+                break;
+            }
+            done += w;
+        }
+        off += n;
+    }
+    if (ftruncate(fd, 0) == -1) {
+        perror("ftruncate");
+    }
+    lseek(fd, 0, SEEK_SET);
+}
+
+/**
+ * The parallel builtin:
+ *     parallel [-j N] command ... {} ... [::: item ...]
+ * Runs the command (which may be a pipeline with redirections) once for
+ * every item after ":::", or for every line of stdin if there is no ":::".
+ * Like xargs, "parallel command < file" reads the items from the file.
+ * At most N runs (default: the number of CPUs) are alive at once; a new one
+ * starts as soon as one finishes.
+ * @param toks - tokens of the whole command line, toks[0] is "parallel"
+ * @param ntok - number of tokens
+ * @param arena - per-command arena
+ * @return - exit status: the number of failed runs (at most 101), 2 on a
+ *           usage or syntax error
+ */
+int parallel_builtin(struct token *toks, int ntok, struct arena *arena)
+{
+    struct parallel_worker workers[PARALLEL_MAX];
+    struct item_source src = { .in = stdin };
+    struct arena scratch;
+    int njobs = sysconf(_SC_NPROCESSORS_ONLN);
+    int running = 0;
+    int failed = 0;
+    bool stop = false;
+    int null_fd;
+    int tmpl = 1;
+    int sep;
+    const char *item;
+    
+    for (; tmpl < ntok && toks[tmpl].type == TOKEN_WORD && toks[tmpl].text[0] == '-'; tmpl++) {
+        if (strcmp(toks[tmpl].text, "-j") == 0 && tmpl + 1 < ntok) {
+            njobs = atoi(toks[++tmpl].text);
+        } else if (strncmp(toks[tmpl].text, "-j", 2) == 0 && toks[tmpl].text[2] != '\0') {
+            njobs = atoi(toks[tmpl].text + 2);
+        } else {
+            tmpl += strcmp(toks[tmpl].text, "--") == 0;
+            break;
+        }
+    }
+    for (sep = tmpl; sep < ntok; sep++) {
+        if (toks[sep].type == TOKEN_WORD && strcmp(toks[sep].text, ":::") == 0) {
+            break;
+        }
+    }
+    if (sep == tmpl || njobs < 1) {
+        fprintf(stderr, "usage: parallel [-j N] command ... {} ... [::: item ...]\n");
+        return 2;
+    }
+    if (sep < ntok) {
+        src.toks = toks + sep + 1;
+        src.ntok = ntok - sep - 1;
+        for (int i = 0; i < src.ntok; i++) {
+            if (src.toks[i].type != TOKEN_WORD) {
+                fprintf(stderr, "crash: parallel: '%s' is not supported after :::\n", src.toks[i].text);
+                return 2;
+            }
+        }
+    }
+    /* Without ":::", a last "< file" (without {}) holds the items */
+    if (sep == ntok && ntok - tmpl >= 3 && toks[ntok - 2].op == OP_IN
+        && strstr(toks[ntok - 1].text, "{}") == NULL) {
+        src.in = fopen(toks[ntok - 1].text, "re");
+        if (src.in == NULL) {
+            perror(toks[ntok - 1].text);
+            return 1;
+        }
+        sep = ntok - 2;
+    }
+    if (njobs > PARALLEL_MAX) {
+        njobs = PARALLEL_MAX;
+    }
+    
+    for (int i = 0; i < njobs; i++) {
+        workers[i].job = NULL;
+        workers[i].out_fd = -1; // created on first use
+    }
+    null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    arena_init(&scratch, ARENA_CHUNK_SZ);
+    
+    jobs_block();
+    while (true) {
+        while (!stop && running < njobs && (item = next_item(&src)) != NULL) {
+            struct parallel_worker *w = &workers[running];
+    
+            if (w->out_fd == -1 && (w->out_fd = memfd_create("parallel", MFD_CLOEXEC)) == -1) {
+                perror("memfd_create");
+                stop = true;
+                failed++;
+                break;
+            }
+            arena_reset(&scratch);
+            if (launch_item(toks + tmpl, sep - tmpl, item, &scratch, null_fd, w->out_fd, &w->job) == -1) {
+                stop = true;
+                failed = -1;
+                break;
+            }
+            if (w->job == NULL) {
+                failed++;
+                continue;
+            }
+            running++;
+        }
+        if (running == 0) {
+            break;
+        }
+    
+        /* Reap whatever finished; the slots stay packed at the front */
+        bool reaped = false;
+        for (int i = 0; i < running; i++) {
+            struct parallel_worker done = workers[i];
+            int status;
+    
+            if (!job_finished(done.job)) {
+                continue;
+            }
+            status = job_release(done.job);
+            flush_output(done.out_fd);
+            failed += failed >= 0 && status != 0;
+            if (WIFSIGNALED(status) && WTERMSIG(status) == SIGINT) {
+                stop = true; // ^C: finish the runs in flight, start no more
+            }
+            workers[i] = workers[--running];
+            workers[running] = done;
+            workers[running].job = NULL;
+            i--;
+            reaped = true;
+        }
+        if (!reaped) {
+            jobs_suspend();
+        }
+    }
+    jobs_unblock();
+    
+    for (int i = 0; i < njobs; i++) {
+        if (workers[i].out_fd != -1) {
+            close(workers[i].out_fd);
+        }
+    }
+    if (null_fd != -1) {
+        close(null_fd);
+    }
+    arena_free(&scratch);
+    free(src.line);
+    if (src.in != stdin) {
+        fclose(src.in);
+    }
+    if (failed == -1) {
+        return 2;
+    }
+    return failed > 101 ? 101 : failed;
+}
@@ -0,0 +1,30 @@
+/**
+* @file parallel.h
+* @author Ghufran Latif
+* @date 16 Oct. 2026
+* @Header file for parallel.c, the parallel builtin
+*/
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+#include "jobs.h"
+
+/**
+ * Most runs of the command at once ("-j")
+ */
+#define PARALLEL_MAX (JOBS_MAX / 2)
+
+struct arena;
+struct token;
+
+/**
+ * One run slot: the job running in it and the memfd collecting its output
+ */
+struct parallel_worker {
+    struct job *job;
+    int out_fd;
+};
+
+int parallel_builtin(struct token *toks, int ntok, struct arena *arena);
+
+#endif
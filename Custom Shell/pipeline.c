@@ -5,11 +5,20 @@
 * @Pipeline contains all the functions are used to execute and
  * parse commands. Used to populate the array of command line structs
 */
+#define _GNU_SOURCE
 #include "pipeline.h"
 
 #include <stdio.h>
 
+#include <stdio_ext.h>
+
+#include "arena.h"
+#include "builtins.h"
+#include "cmdhash.h"
 #include "debug.h"
+#include "jobs.h"
+#include "profile.h"
+#include "tokenizer.h"
 
 #include <string.h>
 
@@ -25,6 +34,20 @@
 
 #include <sys/wait.h>
 
+#include <errno.h>
+
+#include <spawn.h>
+
+#include <sys/resource.h>
+
+/**
+ * One redirection of a stage, e.g. "2>> errors.log"
+ */
+struct redirect {
+    enum token_op op;   // OP_IN, OP_OUT, OP_APPEND, OP_ERR_OUT, ...
+    char *target;       // file name; NULL for 2>&1
+};
+
 /**
  * struct to be used in the execut pipeline function
  */
@@ -32,135 +55,846 @@
 struct command_line {
     char **tokens;
     bool stdout_pipe;
-    char *stdout_file;
+    struct redirect *redirs; // applied in order, after the pipes
+    int nredirs;
     char* cmnd;
+    const char *path; // resolved through the command hash
 };
 
+int pipestatus[PIPELINE_MAX];
+int pipestatus_count = 0;
+bool spawn_enabled = true;
+
+extern char **environ;
+
 
 /**
- * Parses and executes the given arguement array
- * @param char*tokenize_args[] - arguement array
- * @param line_sz - int, length of the argument array
+ * One pipeline of a command line, e.g. "sleep 5 &". Pipelines joined by &&
+ * and || form an and-or list, which ; or & (or the end of the line) ends.
  */
-
-void execute(char *tokenize_args[], int line_sz){
-//    printf("-Exec. Func\n");
+struct pipeline {
     struct command_line *cmds;
-    cmds = malloc(line_sz * sizeof(struct command_line)); // set the size of cmds array
- 
-    parseargs(tokenize_args, line_sz, cmds);
-    
-    execute_pipeline(cmds, 0);
+    int count;
+    enum token_op op;   // what follows: OP_AND, OP_OR, OP_SEMI, OP_BACKGROUND or OP_NONE
+    char *text;         // as typed, for the jobs listing
+    char *list_text;    // the whole and-or list, on its first pipeline when it runs in the background
+};
 
-    free(cmds);
+/**
+ * A parsed command line: its pipelines, in the order they appear
+ */
+struct command_list {
+    struct pipeline *lines;
+    int count;
+};
 
+/**
+ * Copies the text of a span of tokens as typed
+ * @param first - first token
+ * @param last - last token
+ * @param arena - arena to copy into
+ * @return - the text, or NULL if out of memory
+ */
+static char *span_text(const struct token *first, const struct token *last, struct arena *arena)
+{
+    size_t len = last->start + last->len - first->start;
+    char *text = arena_alloc(arena, len + 1);
+    
+    if (text != NULL) {
+        memcpy(text, first->start, len);
+        text[len] = '\0';
+    }
+    return text;
 }
 
 /**
- * Takes the arguement array and populates an array of command_line structs
- * @param *tokenize_args[] - array of tokenized arguments
- * @param line_sz - size of the tokenized arguments
- * @param cmds - array of command_line structs
+ * Parses the given tokens. The line is a list of pipelines separated by
+ * ';', '&' (run what comes before in the background), '&&' (run the next
+ * pipeline only if this one succeeds) and '||' (only if it fails). The
+ * whole line is parsed before anything is launched, so a syntax error
+ * anywhere runs nothing.
+ * @param toks - tokens from lex_line
+ * @param ntok - int, number of tokens
+ * @param arena - arena the parsed commands are allocated from
+ * @return - the parsed line, or NULL on a syntax error (already reported)
  */
-void parseargs(char *tokenize_args[], int line_sz, struct command_line *cmds)
-{
-    int pipe_count = 0;
-    int counter = 1;
+struct command_list *parse_commands(struct token toks[], int ntok, struct arena *arena){
+    struct command_list *list = arena_alloc(arena, sizeof(struct command_list));
+    int list_first = 0; // first pipeline of the current and-or list
+    int list_tok = 0;   // and its first token
     
-    cmds[pipe_count].tokens = malloc(4096);
-    cmds[pipe_count].tokens[0] = tokenize_args[0];
+    if (list == NULL) {
+        return NULL;
+    }
+    list->lines = arena_alloc(arena, ntok * sizeof(struct pipeline)); // one pipeline per token at most
+    list->count = 0;
+    if (list->lines == NULL) {
+        return NULL;
+    }
     
-    for(int i = 1; i < line_sz; i++){
-        if (strcmp(tokenize_args[i], ">")  == 0) { // iterate through the cmds array and add
-            cmds[pipe_count].stdout_file = tokenize_args[i+1];
-            cmds[pipe_count].stdout_pipe = false;
-            tokenize_args[i] = NULL;
-            return;
+    for (int start = 0; start < ntok; list->count++) {
+        struct pipeline *pl = &list->lines[list->count];
+        int end = start;
+        
+        while (end < ntok && toks[end].type != TOKEN_SEPARATOR) {
+            end++;
+        }
+        pl->op = end < ntok ? toks[end].op : OP_NONE;
+        pl->list_text = NULL;
+        if (end == start) {
+            fprintf(stderr, "crash: syntax error near '%s'\n", toks[end].text);
+            return NULL;
+        }
+        if ((pl->op == OP_AND || pl->op == OP_OR) && end + 1 == ntok) {
+            fprintf(stderr, "crash: syntax error: missing command after '%s'\n", toks[end].text);
+            return NULL;
+        }
+        pl->cmds = arena_calloc(arena, end - start + 1, sizeof(struct command_line)); // one stage per token at most
+        if (pl->cmds == NULL) {
+            return NULL;
+        }
+        pl->count = parseargs(toks + start, end - start, pl->cmds, arena);
+        if (pl->count == -1) {
+            return NULL;
         }
         
-        else if(strcmp(tokenize_args[i], "|")  == 0 ){
-            cmds[pipe_count].stdout_pipe = true;
-            cmds[pipe_count].tokens[counter] = NULL;
-            pipe_count++;
-            cmds[pipe_count].tokens = malloc(4096);
-            *cmds[pipe_count].tokens = tokenize_args[i+1];
+        /* Spans of the first and last token give the text as typed */
+        pl->text = span_text(&toks[start], &toks[end - 1], arena);
+        if (pl->text == NULL) {
+            return NULL;
+        }
+        if (pl->op != OP_AND && pl->op != OP_OR) {
+            struct pipeline *first = &list->lines[list_first];
+            
+            if (pl->op == OP_BACKGROUND && first != pl) {
+                first->list_text = span_text(&toks[list_tok], &toks[end - 1], arena);
+                if (first->list_text == NULL) {
+                    return NULL;
+                }
+            }
+            list_first = list->count + 1;
+            list_tok = end + 1;
+        }
+        start = end + 1;
+    }
+    return list;
+}
+
+/**
+ * Runs an and-or list in the foreground. After each pipeline, the next one
+ * runs only if the operator between them agrees with the last status: &&
+ * after a success, || after a failure. A skipped pipeline is never
+ * launched and leaves the status as it was, so "false && a || b" runs b.
+ * @param lines - the pipelines of the list
+ * @param count - how many
+ * @return - wait status of the last pipeline that ran
+ */
+static int run_and_or(struct pipeline *lines, int count)
+{
+    int status = execute_pipeline(lines[0].cmds, lines[0].count, lines[0].text, false);
     
-            tokenize_args[i] = NULL;
-            counter = 0;
+    for (int i = 1; i < count; i++) {
+        if ((lines[i - 1].op == OP_AND) == (status == 0)) {
+            status = execute_pipeline(lines[i].cmds, lines[i].count, lines[i].text, false);
+        }
+    }
+    return status;
+}
 
-        }else{
-            cmds[pipe_count].tokens[counter] = tokenize_args[i];
-            cmds[pipe_count].stdout_pipe = false;
-            counter+=1;
+/**
+ * Runs an and-or list ended by '&' in a forked copy of the shell, which is
+ * a job of its own. The copy runs the pipelines one after another, like
+ * run_and_or, without job control.
+ * @param lines - the pipelines of the list
+ * @param count - how many
+ * @return - 0, or a wait status if nothing could be launched
+ */
+static int run_background_list(struct pipeline *lines, int count)
+{
+    pid_t pgid = job_control ? 0 : -1;
+    uint64_t started = profile_now();
+    struct job *job;
+    pid_t pid;
+    
+    jobs_block();
+    job = job_new(lines[0].list_text);
+    if (job == NULL) {
+        jobs_unblock();
+        return 1 << 8;
+    }
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+        int status;
+        
+        job_child(pgid);
+        if (!job_control) {
+            /* Same as a background pipeline: it may not read the shell's input */
+            int null_fd = open("/dev/null", O_RDONLY);
+            if (null_fd != -1) {
+                dup2(null_fd, STDIN_FILENO);
+                close(null_fd);
+            }
         }
+        job_control = false;
+        status = run_and_or(lines, count);
+        fflush(stdout);
+        _exit(WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status));
     }
-    cmds[pipe_count].tokens[counter] = 0;
+    if (pid == -1) {
+        perror("fork");
+    } else if (pgid != -1) {
+        setpgid(pid, pid);
+    }
+    job_add_proc(job, pid, 1 << 8, lines[0].cmds[0].tokens[0], started);
+    job_background(job);
+    jobs_unblock();
+    return 0;
 }
 
 /**
- * Exectues an array of command_line structs recursively
- * @param cmds - of type struct command_line - the array of commands
- * @param index - the inext to keep track within the array
+ * Runs a parsed command line. It can be run again: nothing in it is
+ * changed but the command paths, which are looked up on every launch.
+ * @param list - from parse_commands
+ * @return - wait status of the last foreground pipeline, 0 if there is none
  */
+int run_commands(struct command_list *list){
+    int status = 0;
+    
+    for (int i = 0; i < list->count; ) {
+        struct pipeline *pl = &list->lines[i];
+        int end = i;
+        
+        while (list->lines[end].op == OP_AND || list->lines[end].op == OP_OR) {
+            end++;
+        }
+        if (list->lines[end].op != OP_BACKGROUND) {
+            status = run_and_or(pl, end - i + 1);
+        } else if (end == i) {
+            execute_pipeline(pl->cmds, pl->count, pl->text, true);
+        } else {
+            run_background_list(pl, end - i + 1);
+        }
+        i = end + 1;
+    }
+    return status;
+}
+
+/**
+ * Parses and executes the given tokens
+ * @param toks - tokens from lex_line
+ * @param ntok - int, number of tokens
+ * @param arena - per-command arena the parsed commands are allocated from
+ * @return - wait status of the last foreground pipeline, 0 if there is none
+ */
+
+int execute(struct token toks[], int ntok, struct arena *arena){
+    struct command_list *list = parse_commands(toks, ntok, arena);
+    
+    if (list == NULL) {
+        pipestatus[0] = 2;
+        pipestatus_count = 1;
+        return 2 << 8;
+    }
+    return run_commands(list);
+}
 
-void execute_pipeline(struct command_line *cmds, int index)
+/**
+ * Takes the tokens and populates an array of command_line structs, one per
+ * pipeline stage. Each stage gets its own NULL terminated argv and list of
+ * redirections from the arena.
+ * @param toks - tokens from lex_line
+ * @param ntok - number of tokens
+ * @param cmds - array of command_line structs
+ * @param arena - arena the argument arrays are allocated from
+ * @return - the number of stages, or -1 on a syntax error
+ */
+int parseargs(struct token toks[], int ntok, struct command_line *cmds, struct arena *arena)
 {
-    /* Creates a pipe. */
-    if(!cmds[index].stdout_pipe){
-        int fd2 = fileno(stdout);
-        if(cmds[index].stdout_file != NULL)
-        {
-            fd2 = open(cmds[index].stdout_file, O_RDWR | O_CREAT | O_TRUNC, 0644);
-            dup2(fd2, fileno(stdout));
+    int pipe_count = 0;
+    int i = 0;
+    
+    while (true) {
+        int words = 0;
+        int argc = 0;
+        
+        int redirs = 0;
+        
+        for (int j = i; j < ntok && toks[j].type != TOKEN_PIPE; j++) {
+            words += toks[j].type == TOKEN_WORD;
+            redirs += toks[j].type == TOKEN_REDIRECT;
+        }
+        cmds[pipe_count].tokens = arena_alloc(arena, (words + 1) * sizeof(char *));
+        cmds[pipe_count].redirs = arena_alloc(arena, redirs * sizeof(struct redirect));
+        if (cmds[pipe_count].tokens == NULL || cmds[pipe_count].redirs == NULL) {
+            return -1;
+        }
+        
+        for (; i < ntok && toks[i].type != TOKEN_PIPE; i++) {
+            if (toks[i].type == TOKEN_WORD) {
+                cmds[pipe_count].tokens[argc++] = toks[i].text;
+            } else if (toks[i].type == TOKEN_REDIRECT) {
+                struct redirect *r = &cmds[pipe_count].redirs[cmds[pipe_count].nredirs++];
+                
+                r->op = toks[i].op;
+                r->target = NULL;
+                if (r->op != OP_ERR_TO_OUT) {
+                    if (i + 1 >= ntok || toks[i+1].type != TOKEN_WORD) {
+                        fprintf(stderr, "crash: syntax error near '%s'\n", toks[i].text);
+                        return -1;
+                    }
+                    r->target = toks[++i].text;
+                }
+            } else {
+                fprintf(stderr, "crash: '%s' is not supported\n", toks[i].text);
+                return -1;
+            }
+        }
+        cmds[pipe_count].tokens[argc] = NULL;
+        if (argc == 0) {
+            fprintf(stderr, "crash: syntax error: missing command\n");
+            return -1;
+        }
+        if (i == ntok) {
+            break;
         }
-        execvp(cmds[index].tokens[0],  cmds[index].tokens);
-        close(STDOUT_FILENO);
-        close(STDIN_FILENO);
+        
+        /* toks[i] is a pipe */
+        if (i + 1 >= ntok) {
+            fprintf(stderr, "crash: syntax error near '|'\n");
+            return -1;
+        }
+        if (pipe_count + 1 >= PIPELINE_MAX) {
+            fprintf(stderr, "crash: more than %d pipeline stages\n", PIPELINE_MAX);
+            return -1;
+        }
+        cmds[pipe_count].stdout_pipe = true;
+        pipe_count++;
+        i++;
+    }
+    return pipe_count + 1;
+}
 
-        close(fd2);
-        exit(1);
+/**
+ * Opens the file of a redirection
+ * @param r - the redirection (not 2>&1)
+ * @param flags - extra open flags, e.g. O_CLOEXEC
+ * @return - the file descriptor, or -1 on error
+ */
+static int open_redirect(const struct redirect *r, int flags)
+{
+    int fd;
+    
+    if (r->op == OP_IN) {
+        flags |= O_RDONLY;
+    } else if (r->op == OP_APPEND || r->op == OP_ERR_APPEND) {
+        flags |= O_WRONLY | O_CREAT | O_APPEND;
+    } else {
+        flags |= O_WRONLY | O_CREAT | O_TRUNC;
+    }
+    fd = open(r->target, flags, 0644);
+    if (fd == -1) {
+        perror(r->target);
     }
+    return fd;
+}
 
-    int fd[2] = { 0 };
-    if (pipe(fd) == -1) {
-        perror("pipe");
+/**
+ * Tells which descriptor a redirection replaces. &> replaces stdout and,
+ * as a second step, stderr.
+ * @param op - the redirection operator
+ * @return - STDIN_FILENO, STDOUT_FILENO or STDERR_FILENO
+ */
+static int redirect_target(enum token_op op)
+{
+    if (op == OP_IN) {
+        return STDIN_FILENO;
+    }
+    if (op == OP_ERR_OUT || op == OP_ERR_APPEND || op == OP_ERR_TO_OUT) {
+        return STDERR_FILENO;
+    }
+    return STDOUT_FILENO;
+}
+
+/**
+ * Wires up the stdin and stdout of a stage in a freshly forked child and
+ * applies its redirections in order. Exits the child on error.
+ * @param cmd - the stage to run
+ * @param in_fd - read end of the previous pipe, or -1 for the shell's stdin
+ * @param out_fd - write end of the next pipe, or -1 for the shell's stdout
+ */
+static void setup_stage(struct command_line *cmd, int in_fd, int out_fd)
+{
+    if (in_fd != -1 && dup2(in_fd, STDIN_FILENO) == -1) {
+        perror("dup2");
+        _exit(EXIT_FAILURE);
+    }
+    if (out_fd != -1 && dup2(out_fd, STDOUT_FILENO) == -1) {
+        perror("dup2");
+        _exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < cmd->nredirs; i++) {
+        const struct redirect *r = &cmd->redirs[i];
+        int fd;
         
+        if (r->op == OP_ERR_TO_OUT) {
+            dup2(STDOUT_FILENO, STDERR_FILENO);
+            continue;
+        }
+        fd = open_redirect(r, 0);
+        if (fd == -1) {
+            _exit(EXIT_FAILURE);
+        }
+        dup2(fd, redirect_target(r->op));
+        if (r->op == OP_ALL_OUT) {
+            dup2(fd, STDERR_FILENO);
+        }
+        close(fd);
     }
+}
+
+/**
+ * Runs one stage in a freshly forked child: sets up its descriptors, then
+ * replaces the child with the command. Never returns.
+ * @param cmd - the stage to run
+ * @param in_fd - read end of the previous pipe, or -1 for the shell's stdin
+ * @param out_fd - write end of the next pipe, or -1 for the shell's stdout
+ */
+static void exec_stage(struct command_line *cmd, int in_fd, int out_fd)
+{
+    setup_stage(cmd, in_fd, out_fd);
     
+    /* Every pipe was created close-on-exec, so the command only keeps the
+     * ends that were just dup'd onto stdin and stdout. */
+    execv(cmd->path, cmd->tokens);
+    /* e.g. a script without #!, which execvp hands to /bin/sh */
+    execvp(cmd->tokens[0], cmd->tokens);
+    fprintf(stderr, "crash: %s: command not found\n", cmd->tokens[0]);
+    _exit(127);
+}
+
+/**
+ * Runs a builtin that takes the whole line (e.g. parallel) as a stage of a
+ * pipeline, in the forked child: its words are turned back into tokens
+ * @param b - the builtin
+ * @param cmd - the stage
+ * @return - exit code of the builtin
+ */
+static int run_line_stage(const struct builtin *b, struct command_line *cmd)
+{
+    struct arena arena;
+    struct token *toks;
+    int n = 0;
+    
+    while (cmd->tokens[n] != NULL) {
+        n++;
+    }
+    arena_init(&arena, ARENA_CHUNK_SZ);
+    toks = arena_alloc(&arena, n * sizeof(struct token));
+    if (toks == NULL) {
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < n; i++) {
+        toks[i].type = TOKEN_WORD;
+        toks[i].op = OP_NONE;
+        toks[i].start = cmd->tokens[i];
+        toks[i].len = strlen(cmd->tokens[i]);
+        toks[i].text = cmd->tokens[i];
+    }
+    return b->run_line(toks, n, &arena);
+}
+
+/**
+ * Runs a builtin as a stage of a pipeline (or in the background), in a
+ * forked child, since its output goes to the next stage. A builtin that
+ * takes the whole line only gets the words of its stage, e.g.
+ * "find . -name '*.log' | parallel gzip" reads its items from the pipe.
+ * @param b - the builtin
+ * @param cmd - the stage to run
+ * @param in_fd - read end of the previous pipe, or -1 for the shell's stdin
+ * @param out_fd - write end of the next pipe, or -1 for the shell's stdout
+ * @param pgid - process group to join (0 for a new one), or -1 for none
+ * @param pipes - every pipe of the pipeline
+ * @param npipes - number of pipes
+ * @return - pid of the child, or -1 on error
+ */
+static pid_t fork_builtin(const struct builtin *b, struct command_line *cmd, int in_fd, int out_fd, pid_t pgid,
+                          int pipes[][2], int npipes)
+{
     pid_t pid = fork();
+    
+    if (pid == -1) {
+        perror("fork");
+    } else if (pid == 0) {
+        int code;
+        
+        job_child(pgid);
+        setup_stage(cmd, in_fd, out_fd);
+        /* The child never execs, so close-on-exec does not drop the other
+         * pipe ends. A read end of its own output pipe would keep it from
+         * ever getting EPIPE once the reader is gone. */
+        for (int i = 0; i < npipes; i++) {
+            close(pipes[i][0]);
+            close(pipes[i][1]);
+        }
+        __fpurge(stdin); // input the shell had buffered is not this stage's
+        job_control = false;
+        code = b->run != NULL ? b->run(cmd->tokens) : run_line_stage(b, cmd);
+        fflush(stdout);
+        _exit(code);
+    } else if (pgid != -1) {
+        setpgid(pid, pgid == 0 ? pid : pgid);
+    }
+    return pid;
+}
 
-    if(pid == -1)
-    {
-        fprintf(stderr, "Fork error\n");
+/**
+ * Runs a builtin that is a command of its own in the shell process. Its
+ * redirections are applied to the shell's descriptors and undone after.
+ * @param b - the builtin
+ * @param cmd - the command
+ * @param text - the command as typed, for the profile
+ * @return - wait status of the builtin
+ */
+static int run_builtin(const struct builtin *b, struct command_line *cmd, const char *text)
+{
+    int saved[3] = { -1, -1, -1 };
+    bool profiled = profile_enabled();
+    struct rusage before;
+    uint64_t started = 0;
+    int code = 1;
+    int i;
+    
+    if (profiled) {
+        started = profile_now();
+        getrusage(RUSAGE_SELF, &before);
     }
-    else if (pid == 0){
+    fflush(stdout);
+    for (i = 0; i < cmd->nredirs; i++) {
+        const struct redirect *r = &cmd->redirs[i];
+        int target = redirect_target(r->op);
+        int fd;
         
+        if (saved[target] == -1) {
+            saved[target] = fcntl(target, F_DUPFD_CLOEXEC, 10);
+        }
+        if (r->op == OP_ALL_OUT && saved[STDERR_FILENO] == -1) {
+            saved[STDERR_FILENO] = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 10);
+        }
+        if (r->op == OP_ERR_TO_OUT) {
+            dup2(STDOUT_FILENO, STDERR_FILENO);
+            continue;
+        }
+        fd = open_redirect(r, O_CLOEXEC);
+        if (fd == -1) {
+            break;
+        }
+        dup2(fd, target);
+        if (r->op == OP_ALL_OUT) {
+            dup2(fd, STDERR_FILENO);
+        }
+        close(fd);
+    }
+    
+    pipestatus_count = 0;
+    if (i == cmd->nredirs) {
+        code = b->run(cmd->tokens);
+    }
+    if (pipestatus_count == 0) {
+        /* fg and wait leave the statuses of the job they waited for */
+        pipestatus[0] = code;
+        pipestatus_count = 1;
+    }
+    
+    fflush(stdout);
+    fflush(stderr);
+    for (int fd = 0; fd < 3; fd++) {
+        if (saved[fd] != -1) {
+            dup2(saved[fd], fd);
+            close(saved[fd]);
+        }
+    }
+    if (profiled) {
+        profile_builtin(cmd->tokens[0], text, started, &before, code << 8);
+    }
+    return code << 8;
+}
+
+/**
+ * Launches one stage with fork and exec_stage.
+ * @param cmd - the stage to run
+ * @param in_fd - read end of the previous pipe, or -1 for the shell's stdin
+ * @param out_fd - write end of the next pipe, or -1 for the shell's stdout
+ * @param pgid - process group to join (0 for a new one), or -1 for none
+ * @return - pid of the child, or -1 on error
+ */
+static pid_t fork_stage(struct command_line *cmd, int in_fd, int out_fd, pid_t pgid)
+{
+    pid_t pid = fork();
+    
+    if (pid == -1) {
+        perror("fork");
+    } else if (pid == 0) {
         /* Child */
-        close(fd[0]);// close the read file des
+        job_child(pgid);
+        exec_stage(cmd, in_fd, out_fd);
+    } else if (pgid != -1) {
+        /* Also from the parent, so the group exists before we wait on it */
+        setpgid(pid, pgid == 0 ? pid : pgid);
+    }
+    return pid;
+}
 
-       if (dup2(fd[1], fileno(stdout)) == -1) {
-              perror("dup2");
+/**
+ * Launches one stage with posix_spawn, which does not copy the shell's page
+ * tables. The pipe ends become dup2 file actions. Redirection files are
+ * opened here in the shell, so their errors are reported before anything
+ * runs, and dup'd by further file actions in the order they were written
+ * (so "2>&1 | next" and "> file 2>&1" behave as in other shells).
+ * If a path remembered by the command hash has disappeared, $PATH is
+ * searched again once. Falls back to fork_stage for what posix_spawn cannot
+ * do: scripts without
+ * a #! line (which execvp hands to /bin/sh) or a failure of the spawn
+ * machinery itself.
+ * @param cmd - the stage to run
+ * @param in_fd - read end of the previous pipe, or -1 for the shell's stdin
+ * @param out_fd - write end of the next pipe, or -1 for the shell's stdout
+ * @param pgid - process group to join (0 for a new one), or -1 for none
+ * @param status - set to a wait status when nothing could be launched
+ * @return - pid of the child, or -1 on error
+ */
+static pid_t spawn_stage(struct command_line *cmd, int in_fd, int out_fd, pid_t pgid, int *status)
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    int file_fds[cmd->nredirs > 0 ? cmd->nredirs : 1];
+    int opened = 0;
+    pid_t pid;
+    int rv;
+    
+    for (; opened < cmd->nredirs; opened++) {
+        file_fds[opened] = -1;
+        if (cmd->redirs[opened].op != OP_ERR_TO_OUT) {
+            file_fds[opened] = open_redirect(&cmd->redirs[opened], O_CLOEXEC);
+            if (file_fds[opened] == -1) {
+                break;
+            }
         }
-
-        /* Process what we recieved */
+    }
+    if (opened < cmd->nredirs || posix_spawn_file_actions_init(&actions) != 0) {
+        bool failed = opened < cmd->nredirs;
+        
+        for (int i = 0; i < opened; i++) {
+            if (file_fds[i] != -1) {
+                close(file_fds[i]);
+            }
+        }
+        if (failed) {
+            *status = 1 << 8;
+            return -1;
+        }
+        return fork_stage(cmd, in_fd, out_fd, pgid);
+    }
+    posix_spawnattr_init(&attr);
+    job_spawnattr(&attr, pgid);
+    
+    if (in_fd != -1) {
+        posix_spawn_file_actions_adddup2(&actions, in_fd, STDIN_FILENO);
+    }
+    if (out_fd != -1) {
+        posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+    }
+    for (int i = 0; i < cmd->nredirs; i++) {
+        enum token_op op = cmd->redirs[i].op;
         
-        execvp(cmds[index].tokens[0], cmds[index].tokens);
+        if (op == OP_ERR_TO_OUT) {
+            posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+            continue;
+        }
+        posix_spawn_file_actions_adddup2(&actions, file_fds[i], redirect_target(op));
+        if (op == OP_ALL_OUT) {
+            posix_spawn_file_actions_adddup2(&actions, file_fds[i], STDERR_FILENO);
+        }
+    }
+    
+    rv = posix_spawn(&pid, cmd->path, &actions, &attr, cmd->tokens, environ);
+    if (rv == ENOENT && (cmd->path = cmdhash_refresh(cmd->tokens[0])) != NULL) {
+        rv = posix_spawn(&pid, cmd->path, &actions, &attr, cmd->tokens, environ);
+    }
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    for (int i = 0; i < cmd->nredirs; i++) {
+        if (file_fds[i] != -1) {
+            close(file_fds[i]);
+        }
+    }
+    
+    if (rv == 0) {
+        return pid;
+    }
+    if (rv == ENOENT) {
+        fprintf(stderr, "crash: %s: command not found\n", cmd->tokens[0]);
+        *status = 127 << 8;
+        return -1;
+    }
+    if (rv == EACCES) {
+        fprintf(stderr, "crash: %s: %s\n", cmd->tokens[0], strerror(rv));
+        *status = 126 << 8;
+        return -1;
+    }
+    LOG("posix_spawn(%s): %s, falling back to fork\n", cmd->path, strerror(rv));
+    return fork_stage(cmd, in_fd, out_fd, pgid);
+}
 
-        close(fd[1]);
-        close(STDOUT_FILENO);
-        close(STDIN_FILENO);
-        exit(EXIT_FAILURE);
+/**
+ * Launches an array of command_line structs as one job, without waiting for
+ * it. All pipes are created up front and every stage is launched from the
+ * shell itself (spawn_stage, or fork_stage when spawning is disabled), so
+ * the stages are siblings. SIGCHLD must be blocked by the caller, from
+ * before this call until it is done with the job.
+ * @param cmds - of type struct command_line - the array of commands
+ * @param count - the number of stages
+ * @param text - the command as typed, for the jobs listing
+ * @param in_fd - stdin of the first stage, or -1 for the shell's stdin
+ * @param out_fd - stdout of the last stage, or -1 for the shell's stdout
+ * @param own_group - with job control, put the job in its own process group
+ * @return - the job, or NULL if the job table is full
+ */
+struct job *launch_pipeline(struct command_line *cmds, int count, const char *text,
+                            int in_fd, int out_fd, bool own_group)
+{
+    int fds[PIPELINE_MAX - 1][2];
+    int created = 0;
+    struct job *job;
+    
+    job = job_new(text);
+    if (job == NULL) {
+        return NULL;
+    }
+    
+    for (int i = 0; i < count - 1; i++) {
+        if (pipe2(fds[i], O_CLOEXEC) == -1) {
+            perror("pipe");
+            break;
+        }
+        created++;
+    }
+    fflush(stdout); // anything the shell printed comes before the output of the job
+    
+    for (int i = 0; i < count; i++) {
+        int stage_in = i > 0 ? fds[i-1][0] : in_fd;
+        int stage_out = i < count - 1 ? fds[i][1] : out_fd;
+        pid_t pgid = job_control && own_group ? job->pgid : -1;
+        int launch_status = 1 << 8;
+        const struct builtin *builtin;
+        uint64_t started = profile_now();
+        pid_t pid = -1;
         
-    } else
-    {
-        /* Parent */
-        close(fd[1]); // close the write file des
-        if (dup2(fd[0], fileno(stdin)) == -1) {
-              perror("dup2");
+        if (created < count - 1) {
+            job_add_proc(job, pid, launch_status, cmds[i].tokens[0], started);
+            continue;
+        }
+        builtin = builtin_find(cmds[i].tokens[0]);
+        if (builtin != NULL) {
+            pid = fork_builtin(builtin, &cmds[i], stage_in, stage_out, pgid, fds, created);
+            job_add_proc(job, pid, launch_status, cmds[i].tokens[0], started);
+            continue;
         }
-        index++;
-        execute_pipeline(cmds, index);
-        close(fd[0]);
+        cmds[i].path = cmdhash_lookup(cmds[i].tokens[0]);
+        if (cmds[i].path == NULL) {
+            fprintf(stderr, "crash: %s: command not found\n", cmds[i].tokens[0]);
+            job_add_proc(job, pid, 127 << 8, cmds[i].tokens[0], started);
+            continue;
+        }
+        if (spawn_enabled) {
+            pid = spawn_stage(&cmds[i], stage_in, stage_out, pgid, &launch_status);
+        } else {
+            pid = fork_stage(&cmds[i], stage_in, stage_out, pgid);
+        }
+        job_add_proc(job, pid, launch_status, cmds[i].tokens[0], started);
+    }
+    
+    /* Parent: only the children may hold the pipes open */
+    for (int i = 0; i < created; i++) {
+        close(fds[i][0]);
+        close(fds[i][1]);
+    }
+    return job;
+}
+
+/**
+ * Executes an array of command_line structs as one job. A foreground job is
+ * waited for and its exit codes recorded in pipestatus; a background job is
+ * left to the SIGCHLD reaper. A builtin on its own in the foreground runs in
+ * the shell, without a job. Without job control a background job reads
+ * from /dev/null, so it cannot eat the shell's input.
+ * @param cmds - of type struct command_line - the array of commands
+ * @param count - the number of stages
+ * @param text - the command as typed, for the jobs listing
+ * @param background - true to run it in the background
+ * @return - wait status of the last stage (0 in the background)
+ */
+
+int execute_pipeline(struct command_line *cmds, int count, const char *text, bool background)
+{
+    int null_fd = -1;
+    int status = 0;
+    struct job *job;
+    
+    if (count == 1 && !background) {
+        const struct builtin *b = builtin_find(cmds[0].tokens[0]);
+        if (b != NULL && b->run != NULL) {
+            return run_builtin(b, &cmds[0], text);
+        }
+    }
+    if (background && !job_control) {
+        null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    }
+    jobs_block();
+    job = launch_pipeline(cmds, count, text, null_fd, -1, true);
+    if (null_fd != -1) {
+        close(null_fd);
+    }
+    if (job == NULL) {
+        status = 1 << 8;
+    } else if (background) {
+        job_background(job);
+    } else {
+        status = job_foreground(job, false);
     }
+    jobs_unblock();
+    return status;
 }
 
+/**
+ * Parses tokens as a single pipeline and launches it, see launch_pipeline.
+ * Used by builtins that run commands of their own, e.g. parallel. The
+ * caller owns the job until it calls job_release.
+ * @param toks - tokens of the pipeline
+ * @param ntok - number of tokens
+ * @param arena - arena the parsed commands are allocated from
+ * @param in_fd - stdin of the first stage, or -1 for the shell's stdin
+ * @param out_fd - stdout of the last stage, or -1 for the shell's stdout
+ * @param job - set to the job, NULL if the job table is full
+ * @return - 0, or -1 on a syntax error
+ */
+int launch_tokens(struct token *toks, int ntok, struct arena *arena, int in_fd, int out_fd, struct job **job)
+{
+    struct command_line *cmds;
+    int count;
+    
+    *job = NULL;
+    cmds = arena_calloc(arena, ntok + 1, sizeof(struct command_line)); // one stage per token at most
+    if (cmds == NULL) {
+        return -1;
+    }
+    count = parseargs(toks, ntok, cmds, arena);
+    if (count == -1) {
+        return -1;
+    }
+    *job = launch_pipeline(cmds, count, cmds[0].tokens[0], in_fd, out_fd, false);
+    if (*job != NULL) {
+        (*job)->held = true;
+    }
+    return 0;
+}
@@ -4,14 +4,41 @@
 * @date 1 Nov. 2019
 * @Initializes the pipeline function
 */
+#include <stdbool.h>
 #include <stddef.h>
 #ifndef _PIPELINE_H_
 #define _PIPELINE_H_
 
+/**
+ * Most stages a single pipeline may have
+ */
+#define PIPELINE_MAX 256
+
+/**
+ * Exit codes of every stage of the last pipeline, like PIPESTATUS in bash.
+ * A stage killed by a signal reports 128 + the signal number.
+ */
+extern int pipestatus[PIPELINE_MAX];
+extern int pipestatus_count;
+
+/**
+ * Launch stages with posix_spawn (true, the default) or with fork
+ */
+extern bool spawn_enabled;
+
+struct arena;
 struct command_line;
-void execute_pipeline(struct command_line *cmds, int index);
-void parseargs(char *tokenize_args[], int line_sz, struct command_line *cmds);
-void execute(char *tokenize_args[], int line_sz);
+struct command_list;
+struct job;
+struct token;
+struct job *launch_pipeline(struct command_line *cmds, int count, const char *text,
+                            int in_fd, int out_fd, bool own_group);
+int execute_pipeline(struct command_line *cmds, int count, const char *text, bool background);
+int launch_tokens(struct token *toks, int ntok, struct arena *arena, int in_fd, int out_fd, struct job **job);
+int parseargs(struct token *toks, int ntok, struct command_line *cmds, struct arena *arena);
+struct command_list *parse_commands(struct token *toks, int ntok, struct arena *arena);
+int run_commands(struct command_list *list);
+int execute(struct token *toks, int ntok, struct arena *arena);
 
 
 #endif
@@ -0,0 +1,260 @@
+/**
+* @file profile.c
+* @author Ghufran Latif
+* @date 16 Oct. 2026
+* @Timing of the commands the shell runs. Every process records when its
+ * launch began, when posix_spawn (or fork) returned and when it was reaped,
+ * with its CPU time from wait4 (see jobs.c). When a job leaves the job
+ * table its processes are written to $CRASH_PROFILE, one line each, and
+ * handed to the time builtin if it is collecting them.
+*/
+#include "profile.h"
+
+#include <stdio.h>
+
+#include "arena.h"
+#include "debug.h"
+#include "pipeline.h"
+#include "tokenizer.h"
+
+#include <string.h>
+
+#include <stdlib.h>
+
+#include <fcntl.h>
+
+#include <time.h>
+
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include <sys/wait.h>
+
+static int profile_fd = -1;
+
+/* Stages the time builtin is collecting, NULL when it is not running */
+static struct profile_stage *timed = NULL;
+static int timed_count = 0;
+static int timed_max = 0;
+
+/**
+ * Monotonic clock in nanoseconds. Async-signal-safe, for the SIGCHLD
+ * handler.
+ * @return - the time
+ */
+uint64_t profile_now()
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Opens the profile every command is recorded in. Lines are appended, so
+ * several shells (e.g. parallel scripts) can share one file.
+ * @param path - the file, or NULL for no profile
+ */
+void profile_open(const char *path)
+{
+    struct stat st;
+    
+    if (path == NULL || *path == '\0') {
+        return;
+    }
+    profile_fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (profile_fd == -1) {
+        perror(path);
+        return;
+    }
+    if (fstat(profile_fd, &st) == 0 && st.st_size == 0) {
+        dprintf(profile_fd, "# pid\tlaunch_us\twall_us\tuser_us\tsys_us\tstatus\tstage\tcommand\n");
+    }
+    LOG("Profiling commands to %s\n", path);
+}
+
+/**
+ * Tells whether commands are being timed, so builtins know to measure
+ * themselves
+ * @return - true with $CRASH_PROFILE or inside the time builtin
+ */
+bool profile_enabled()
+{
+    return profile_fd != -1 || timed != NULL;
+}
+
+/**
+ * Exit code of a wait status
+ * @param status - wait status
+ * @return - the exit code, or 128 + the signal number
+ */
+static int exit_code(int status)
+{
+    return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+}
+
+/**
+ * Records one command: a line of the profile, and a stage for the time
+ * builtin
+ * @param stage - its timings
+ * @param pid - its process, 0 for a builtin run in the shell
+ * @param index - stage number, from 1
+ * @param count - stages in its pipeline
+ * @param text - the pipeline as typed
+ */
+static void record(const struct profile_stage *stage, pid_t pid, int index, int count, const char *text)
+{
+    if (profile_fd != -1) {
+        char line[JOB_TEXT_MAX + 128];
+        int len = snprintf(line, sizeof(line), "%d\t%.1f\t%.1f\t%llu\t%llu\t%d\t%d/%d\t%s\n",
+                           (int) pid, stage->launch_ns / 1000.0, stage->wall_ns / 1000.0,
+                           (unsigned long long) stage->user_us, (unsigned long long) stage->sys_us,
+                           exit_code(stage->status), index, count, text);
+        
+        if (len >= (int) sizeof(line)) {
+            len = sizeof(line) - 1;
+            line[len - 1] = '\n';
+        }
+        /* One write per line: with O_APPEND, lines from several shells do not mix */
+        if (write(profile_fd, line, len) == -1) {
+            perror("profile");
+        }
+    }
+    if (timed != NULL && timed_count < timed_max) {
+        timed[timed_count++] = *stage;
+    }
+}
+
+/**
+ * Records the processes of a job that is leaving the job table
+ * @param job - the job
+ */
+void profile_job(const struct job *job)
+{
+    if (!profile_enabled() || job->id == 0) {
+        return;
+    }
+    for (int i = 0; i < job->nprocs; i++) {
+        const struct job_proc *proc = &job->procs[i];
+        struct profile_stage stage;
+        
+        if (!proc->done) {
+            continue;
+        }
+        snprintf(stage.name, sizeof(stage.name), "%s", proc->name);
+        stage.status = proc->status;
+        stage.launch_ns = proc->launched_ns - proc->started_ns;
+        stage.wall_ns = proc->ended_ns - proc->started_ns;
+        stage.user_us = proc->user_us;
+        stage.sys_us = proc->sys_us;
+        record(&stage, proc->pid > 0 ? proc->pid : 0, i + 1, job->nprocs, job->text);
+    }
+}
+
+/**
+ * Records a builtin that ran in the shell process
+ * @param name - the builtin
+ * @param text - the command as typed
+ * @param started - profile_now() from before it ran
+ * @param before - getrusage(RUSAGE_SELF) from before it ran
+ * @param status - its wait status
+ */
+void profile_builtin(const char *name, const char *text, uint64_t started,
+                     const struct rusage *before, int status)
+{
+    struct profile_stage stage;
+    struct rusage after;
+    
+    getrusage(RUSAGE_SELF, &after);
+    snprintf(stage.name, sizeof(stage.name), "%s", name);
+    stage.status = status;
+    stage.launch_ns = 0;
+    stage.wall_ns = profile_now() - started;
+    stage.user_us = (after.ru_utime.tv_sec - before->ru_utime.tv_sec) * 1000000LL
+                    + (after.ru_utime.tv_usec - before->ru_utime.tv_usec);
+    stage.sys_us = (after.ru_stime.tv_sec - before->ru_stime.tv_sec) * 1000000LL
+                   + (after.ru_stime.tv_usec - before->ru_stime.tv_usec);
+    record(&stage, 0, 1, 1, text);
+}
+
+/**
+ * CPU time between two getrusage calls, in microseconds
+ * @param a - the first
+ * @param b - the second
+ * @param user - true for user time, false for system time
+ * @return - the difference
+ */
+static long long usage_diff(const struct rusage *a, const struct rusage *b, bool user)
+{
+    const struct timeval *ta = user ? &a->ru_utime : &a->ru_stime;
+    const struct timeval *tb = user ? &b->ru_utime : &b->ru_stime;
+    
+    return (tb->tv_sec - ta->tv_sec) * 1000000LL + (tb->tv_usec - ta->tv_usec);
+}
+
+/**
+ * Prints a time like bash does, e.g. "0m1.250s"
+ * @param label - "real", "user" or "sys"
+ * @param us - the time in microseconds
+ */
+static void print_time(const char *label, long long us)
+{
+    fprintf(stderr, "%s\t%lldm%d.%03ds\n", label, us / 60000000, (int) (us / 1000000 % 60),
+            (int) (us / 1000 % 1000));
+}
+
+/**
+ * time command ...: runs a command line (pipelines, lists) and reports its
+ * wall, user and system time on stderr, then one line per command that
+ * ran: its own wall and CPU time, how long its launch took and its status
+ * @param toks - the tokens, "time" first
+ * @param ntok - number of tokens
+ * @param arena - arena the command is parsed into
+ * @return - exit code of the command, 2 on a syntax error
+ */
+int time_builtin(struct token *toks, int ntok, struct arena *arena)
+{
+    struct profile_stage stages[PIPELINE_MAX];
+    struct command_list *list = NULL;
+    struct rusage self_before, self_after;
+    struct rusage kids_before, kids_after;
+    uint64_t started;
+    uint64_t wall;
+    int status = 0;
+    
+    if (ntok > 1 && (list = parse_commands(toks + 1, ntok - 1, arena)) == NULL) {
+        return 2;
+    }
+    
+    getrusage(RUSAGE_SELF, &self_before);
+    getrusage(RUSAGE_CHILDREN, &kids_before);
+    timed = stages;
+    timed_count = 0;
+    timed_max = PIPELINE_MAX;
+    started = profile_now();
+    if (list != NULL) {
+        status = run_commands(list);
+    }
+    wall = profile_now() - started;
+    timed = NULL;
+    getrusage(RUSAGE_SELF, &self_after);
+    getrusage(RUSAGE_CHILDREN, &kids_after);
+    
+    fprintf(stderr, "\n");
+    print_time("real", wall / 1000);
+    print_time("user", usage_diff(&self_before, &self_after, true)
+                       + usage_diff(&kids_before, &kids_after, true));
+    print_time("sys", usage_diff(&self_before, &self_after, false)
+                      + usage_diff(&kids_before, &kids_after, false));
+    if (timed_count > 0) {
+        fprintf(stderr, "\n%-3s %-16s %10s %10s %10s %10s %6s\n",
+                "#", "command", "real ms", "user ms", "sys ms", "launch ms", "status");
+    }
+    for (int i = 0; i < timed_count; i++) {
+        fprintf(stderr, "%-3d %-16s %10.3f %10.3f %10.3f %10.3f %6d\n", i + 1, stages[i].name,
+                stages[i].wall_ns / 1e6, stages[i].user_us / 1e3, stages[i].sys_us / 1e3,
+                stages[i].launch_ns / 1e6, exit_code(stages[i].status));
+    }
+    return exit_code(status);
+}
@@ -0,0 +1,38 @@
+/**
+* @file profile.h
+* @author Ghufran Latif
+* @date 16 Oct. 2026
+* @Header file for profile.c, the time builtin and $CRASH_PROFILE
+*/
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/resource.h>
+
+#include "jobs.h"
+
+/**
+ * Timings of one command that ran, as the time builtin reports them
+ */
+struct profile_stage {
+    char name[JOB_NAME_MAX];
+    int status;             // wait status
+    uint64_t launch_ns;     // from the start of the launch until posix_spawn (or fork) returned
+    uint64_t wall_ns;       // from the start of the launch until it was reaped
+    uint64_t user_us;
+    uint64_t sys_us;
+};
+
+struct arena;
+struct token;
+
+uint64_t profile_now();
+void profile_open(const char *path);
+bool profile_enabled();
+void profile_job(const struct job *job);
+void profile_builtin(const char *name, const char *text, uint64_t started,
+                     const struct rusage *before, int status);
+int time_builtin(struct token *toks, int ntok, struct arena *arena);
+
+#endif
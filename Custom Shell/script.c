@@ -0,0 +1,193 @@
+/**
+* @file script.c
+* @author Ghufran Latif
+* @date 16 Oct. 2026
+* @Loads a script for "crash -f": the file is mapped into memory and lexed
+ * and parsed in one pass into an array of commands, so syntax errors are
+ * found before anything runs and running the script only launches the
+ * commands.
+*/
+#include "script.h"
+
+#include <stdio.h>
+
+#include "debug.h"
+#include "pipeline.h"
+#include "tokenizer.h"
+
+#include <string.h>
+
+#include <stdlib.h>
+
+#include <fcntl.h>
+
+#include <unistd.h>
+
+#include <sys/mman.h>
+
+#include <sys/stat.h>
+
+/**
+ * Maps a file read-only, followed by at least one zero byte: the file is
+ * mapped over a larger anonymous (zero filled) mapping, so the lexer finds
+ * a NUL after the last line even when the size is a multiple of the page
+ * size.
+ * @param sc - the script; map and map_len are filled in
+ * @param path - the file
+ * @return - 0, or -1 on error
+ */
+static int map_script(struct script *sc, const char *path)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    struct stat st;
+    int fd;
+    
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        perror(path);
+        return -1;
+    }
+    if (fstat(fd, &st) == -1) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    
+    sc->map_len = (st.st_size + 1 + page - 1) / page * page;
+    sc->map = mmap(NULL, sc->map_len, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (sc->map == MAP_FAILED) {
+        perror("mmap");
+        close(fd);
+        return -1;
+    }
+    if (st.st_size > 0 &&
+        mmap(sc->map, st.st_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        perror(path);
+        munmap(sc->map, sc->map_len);
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    madvise(sc->map, sc->map_len, MADV_SEQUENTIAL);
+    return 0;
+}
+
+/**
+ * Counts the newlines in a span
+ * @param p - start of the span
+ * @param end - end of the span
+ * @return - the number of newlines
+ */
+static int count_lines(const char *p, const char *end)
+{
+    int n = 0;
+    
+    while ((p = memchr(p, '\n', end - p)) != NULL) {
+        p++;
+        n++;
+    }
+    return n;
+}
+
+/**
+ * Maps a script and lexes and parses every command in it. Lines with a
+ * $VAR are only checked here and lexed again when they run, since the
+ * variable may be set by an earlier line. All syntax errors are reported.
+ * @param sc - the script to fill in
+ * @param path - the file
+ * @param is_builtin - tells apart the builtins that take the whole line,
+ *                     whose arguments are only checked
+ * @return - 0, or -1 if the file could not be read or has syntax errors
+ */
+int script_load(struct script *sc, const char *path, bool (*is_builtin)(const char *name))
+{
+    static struct token toks[SCRIPT_TOKENS_MAX];
+    const char *p;
+    const char *end;
+    int errors = 0;
+    int line = 1;
+    
+    memset(sc, 0, sizeof(*sc));
+    sc->path = path;
+    if (map_script(sc, path) == -1) {
+        return -1;
+    }
+    arena_init(&sc->arena, ARENA_CHUNK_SZ);
+    
+    /* A NUL in the file ends the script, like the end of the file */
+    end = sc->map + strlen(sc->map);
+    sc->cmds = arena_calloc(&sc->arena, count_lines(sc->map, end) + 1, sizeof(struct script_cmd));
+    if (sc->cmds == NULL) {
+        script_free(sc);
+        return -1;
+    }
+    
+    for (p = sc->map; *p != '\0'; ) {
+        const char *start = p;
+        int ntok = lex_command(toks, SCRIPT_TOKENS_MAX, &p, &sc->arena);
+        struct script_cmd *cmd = &sc->cmds[sc->count];
+        bool bad;
+    
+        if (ntok == -1) {
+            fprintf(stderr, "%s: line %d: %.*s\n", path, line, (int) strcspn(start, "\n"), start);
+            errors++;
+        } else if (ntok > 0) {
+            cmd->line = line;
+            cmd->text = start;
+            cmd->ntok = ntok;
+            cmd->toks = arena_alloc(&sc->arena, ntok * sizeof(struct token));
+            if (cmd->toks == NULL) {
+                script_free(sc);
+                return -1;
+            }
+            memcpy(cmd->toks, toks, ntok * sizeof(struct token));
+            cmd->deferred = memchr(start, '$', p - start) != NULL;
+            cmd->builtin = toks[0].type == TOKEN_WORD && is_builtin(toks[0].text);
+            if (cmd->builtin) {
+                /* Only checked: the builtin parses its own arguments. A
+                 * ":::" ends the command template of parallel. */
+                int nargs = 1;
+    
+                while (nargs < ntok && !(toks[nargs].type == TOKEN_WORD && strcmp(toks[nargs].text, ":::") == 0)) {
+                    nargs++;
+                }
+                bad = nargs > 1 && parse_commands(cmd->toks + 1, nargs - 1, &sc->arena) == NULL;
+            } else {
+                cmd->list = parse_commands(cmd->toks, ntok, &sc->arena);
+                bad = cmd->list == NULL;
+                if (cmd->deferred) {
+                    cmd->list = NULL; // only checked, it is parsed again when it runs
+                }
+            }
+            if (bad) {
+                fprintf(stderr, "%s: line %d: %.*s\n", path, line, (int) strcspn(start, "\n"), start);
+                errors++;
+            }
+            sc->count++;
+        }
+        line += count_lines(start, p);
+    }
+    
+    if (errors > 0) {
+        fprintf(stderr, "crash: %s: %d syntax error(s), nothing was run\n", path, errors);
+        script_free(sc);
+        return -1;
+    }
+    LOG("Loaded %d command(s) from %s\n", sc->count, path);
+    return 0;
+}
+
+/**
+ * Unmaps a script and frees its commands
+ * @param sc - the script
+ */
+void script_free(struct script *sc)
+{
+    if (sc->map != NULL) {
+        munmap(sc->map, sc->map_len);
+        sc->map = NULL;
+    }
+    arena_free(&sc->arena);
+    sc->cmds = NULL;
+    sc->count = 0;
+}
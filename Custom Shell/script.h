@@ -0,0 +1,50 @@
+/**
+* @file script.h
+* @author Ghufran Latif
+* @date 16 Oct. 2026
+* @Header file for script.c, which loads "crash -f script" files
+*/
+#ifndef _SCRIPT_H_
+#define _SCRIPT_H_
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "arena.h"
+
+/**
+ * Most tokens on one line of a script
+ */
+#define SCRIPT_TOKENS_MAX 4096
+
+struct command_list;
+struct token;
+
+/**
+ * One command of a script, lexed (and parsed) ahead of time
+ */
+struct script_cmd {
+    int line;                   // line number, for messages
+    const char *text;           // start of the line in the mapping
+    struct token *toks;         // for line builtins, and for the jobs listing
+    int ntok;
+    struct command_list *list;  // parsed pipelines, NULL for line builtins and deferred lines
+    bool builtin;               // a builtin that takes the whole line, e.g. parallel
+    bool deferred;              // uses $VAR: lexed again right before it runs
+};
+
+/**
+ * A script mapped into memory along with its commands
+ */
+struct script {
+    const char *path;
+    char *map;
+    size_t map_len;
+    struct script_cmd *cmds;
+    int count;
+    struct arena arena;         // owns the tokens and parsed commands
+};
+
+int script_load(struct script *sc, const char *path, bool (*is_builtin)(const char *name));
+void script_free(struct script *sc);
+
+#endif
@@ -17,10 +17,19 @@
 #include <sys/wait.h>
 #include <unistd.h>
 #include <ctype.h>
+#include <errno.h>
 #include <limits.h>
+#include <signal.h>
 
+#include "arena.h"
+#include "builtins.h"
 #include "debug.h"
 #include "history.h"
+#include "jobs.h"
+#include "lineedit.h"
+#include "profile.h"
+#include "script.h"
+#include "shell.h"
 #include "tokenizer.h"
 #include "pipeline.h"
 
@@ -30,207 +39,347 @@ int cmnd = 0;
 bool entry_hold = false;
 int status;
 
+/* Owns everything parsed from the current command line */
+struct arena arena;
+
+/* getline reuses (and only grows) this buffer from one line to the next;
+ * on a terminal the line editor reads into it instead, for Ctrl-R */
+static char *line = NULL;
+
+/**
+ * Publishes the per-stage exit codes of the last pipeline as $PIPESTATUS,
+ * space separated (e.g. "0 1 0")
+ */
+void export_pipestatus(){
+    char buf[PIPELINE_MAX * 4 + 1];
+    size_t len = 0;
+    
+    buf[0] = '\0';
+    for(int i = 0; i < pipestatus_count; i++){
+        len += snprintf(buf + len, sizeof(buf) - len, i == 0 ? "%d" : " %d", pipestatus[i]);
+    }
+    setenv("PIPESTATUS", buf, true);
+}
+
+/**
+ * Longest prompt, with the newline the SIGINT handler prints before it
+ */
+#define PROMPT_MAX (PATH_MAX + 2 * HOST_NAME_MAX + 64)
+
+/* Looked up once; the prompt is built from these without system calls */
+static char prompt_host[HOST_NAME_MAX + 1] = "?";
+static char prompt_user[HOST_NAME_MAX + 1] = "?";
+static char prompt_cwd[PATH_MAX] = "?";
+static bool interactive = false;
+
+/* The rendered prompt, "\n" first. There are two so the SIGINT handler
+ * always finds a complete one: a new prompt is rendered into the buffer
+ * not in use, then prompt_cur is switched to it. */
+static char prompt_bufs[2][PROMPT_MAX];
+static size_t prompt_lens[2];
+static volatile sig_atomic_t prompt_cur = -1;
+static int prompt_cmnd = -1;
+static int prompt_status = -1;
+
+/**
+ * Remembers the working directory for the prompt; called at startup and
+ * whenever cd succeeds
+ */
+void prompt_update_cwd(){
+    if(getcwd(prompt_cwd, sizeof(prompt_cwd)) == NULL){
+        strcpy(prompt_cwd, "?");
+    }
+    prompt_cmnd = -1; // render again
+}
+
+/**
+ * Looks up what the prompt shows that never changes
+ */
+void prompt_init(){
+    struct passwd *pw;
+    const char *user = getlogin();
+    
+    interactive = isatty(STDIN_FILENO);
+    if(user == NULL && (pw = getpwuid(getuid())) != NULL){
+        user = pw->pw_name;
+    }
+    if(user != NULL){
+        snprintf(prompt_user, sizeof(prompt_user), "%s", user);
+    }
+    if(gethostname(prompt_host, sizeof(prompt_host)) == -1){
+        strcpy(prompt_host, "?");
+    }
+    prompt_host[sizeof(prompt_host) - 1] = '\0';
+    prompt_update_cwd();
+}
+
 /**
  * Prints prompt given the command number and shows the current working directory
- * and updates emoji according to the status of the process
+ * and updates emoji according to the status of the process. The prompt is
+ * only rendered again when one of them changed, and is written at once.
  * @param int cmnd - command number
  * @param int status - status of child process
 */
 
 void print_prompt(int cmnd, int status){
-    char hostname[HOST_NAME_MAX] = {};
-    char username[HOST_NAME_MAX] = {};
-    char cwd[PATH_MAX];
-    char new_wd[PATH_MAX] = {};
+    int cur = prompt_cur;
     
-    getcwd(cwd, PATH_MAX);
-    
-    char *next_tok = cwd;
-    char *curr_tok;
-    while ((curr_tok = next_token(&next_tok, "/")) != NULL) {
-        strcat(new_wd, "/");
-        strcat(new_wd, curr_tok);
+    if(cur == -1 || cmnd != prompt_cmnd || (status == 0) != (prompt_status == 0)){
+        int next = cur == 0 ? 1 : 0;
+        const char *wd = startswith("/home", prompt_cwd) ? "~" : prompt_cwd;
+        int len = snprintf(prompt_bufs[next], PROMPT_MAX, "\n[%s] - [%d] - [%s@%s: %s] >",
+                           status == 0 ? "\U0001F911" : "\U0001F912",
+                           cmnd, prompt_user, prompt_host, wd);
+        
+        prompt_lens[next] = len < PROMPT_MAX ? len : PROMPT_MAX - 1;
+        prompt_cmnd = cmnd;
+        prompt_status = status;
+        prompt_cur = cur = next;
     }
     
-    if(startswith("/home", cwd)){
-          strcpy(new_wd, "~");
-      }
-     
-    gethostname(hostname, HOST_NAME_MAX);
-    strcpy(username, getlogin());
-
-    
-    if(status == 0){
-        printf("[\U0001F911] - [%d] - [%s@%s: %s] >", cmnd, username, hostname, new_wd);
-    }else{
-        printf("[\U0001F912] - [%d] - [%s@%s: %s] >", cmnd, username, hostname, new_wd);
+    fflush(stdout); // output of builtins comes first
+    if(write(STDOUT_FILENO, prompt_bufs[cur] + 1, prompt_lens[cur] - 1) == -1){
+        perror("write");
     }
-    fflush(stdout);
 }
 
 /**
- *Handles the cntrl+c signal to make sure it doesn't quit
+ * Prints the prompt again when the line editor redraws the line
+ */
+static void redraw_prompt(){
+    print_prompt(cmnd, status);
+}
+
+/**
+ *Handles the cntrl+c signal to make sure it doesn't quit. Only writes the
+ *prompt rendered last, which is safe in a signal handler.
  *@param signo - the signal number
  */
 
 void sigint_handler(int signo) {
-    if(isatty(STDIN_FILENO)){
-        printf("\n");
-        print_prompt(cmnd,status);
-        fflush(stdout);
+    int cur = prompt_cur;
+    
+    if(interactive && cur != -1){
+        int saved = errno;
+        ssize_t rv = write(STDOUT_FILENO, prompt_bufs[cur], prompt_lens[cur]);
+        (void) rv;
+        errno = saved;
     }
 }
 
 
 /**
- * Checks for builtin arguments within the command shelll
- * @param char*args[] - array of arguments to check
- * @param int*line_sz - size of the arguments array
- * @return - int
+ * Exits the shell, for the exit builtin
+ * @param code - exit status
  */
-int customargs(char* args[], int *line_sz, size_t line_sz1, char* ptr2, char* ptr3) {
-    if(strstr(args[0], "#") != NULL) {
-        return 0;
-    }
+void shell_exit(int code){
+    arena_free(&arena);
+    free(line);
+    history_close();
+    exit(code);
+}
 
-    if(strcmp(args[0], "history") == 0) {
-        print_history();
-        return 0;
-    }
-    if(strcmp(args[0], "!!") == 0) {
-        char* cmnd1 = runlastcmnd();
-        if(cmnd1 != NULL){
-            entry_hold = true;
-            *line_sz = tokenize_args(args, cmnd1, line_sz1, ptr2);
-            return -1;
-        }
+/**
+ * Expands "!!", "!N" and "!prefix" from the history and runs the builtins
+ * that take the whole line (see is_line_builtin). The other builtins are
+ * run by execute, like any command.
+ * @param toks - tokens of the line to check
+ * @param int*ntok - number of tokens
+ * @return - 1 if a builtin ran (and set status), -1 if toks was replaced
+ *           from history, else 0
+ */
+int customargs(struct token toks[], int *ntok) {
+    char *args[ARG_MAX];
+    const struct builtin *b;
+    int rv = 0;
+    
+    if(token_argv(toks, *ntok, args, ARG_MAX) == 0) {
         return 0;
     }
 
     if(strstr(args[0], "!") != NULL) {
-        char* cmnd1 = bangFound(args);
-        if(cmnd1 != NULL){
-            entry_hold = true;
-            *line_sz = tokenize_args(args, cmnd1, line_sz1, ptr2);
+        char* cmnd1 = strcmp(args[0], "!!") == 0 ? runlastcmnd() : bangFound(args);
+        if(cmnd1 == NULL){
+            return 0;
+        }
+        entry_hold = true;
+        *ntok = lex_line(toks, ARG_MAX, cmnd1, &arena);
+        if(*ntok <= 0 || token_argv(toks, *ntok, args, ARG_MAX) == 0){
             return -1;
         }
-        return 0;
+        rv = -1;
+    }
+    
+    b = builtin_find(args[0]);
+    if(b != NULL && b->run_line != NULL) {
+        /* Takes the raw tokens: the command may be a whole pipeline */
+        status = b->run_line(toks, *ntok, &arena) << 8;
+        return 1;
+    }
+    return rv;
+}
+
 
+/**
+ * Runs a script given with -f. The whole script is lexed and parsed before
+ * the first command runs; the loop below only launches the commands.
+ * @param path - the script
+ * @return - exit code of the last command, 2 if the script has errors
+ */
+int run_script(const char *path){
+    struct script sc;
+    struct token line_toks[SCRIPT_TOKENS_MAX];
+    
+    if(script_load(&sc, path, is_line_builtin) == -1){
+        return 2;
     }
-    if(strcmp(args[0], "cd") == 0) {
-        if(args[1] != NULL){
-            if(chdir(args[1]) != 0){
-                perror("CHDIR");
+    for(int i = 0; i < sc.count; i++){
+        struct script_cmd *cmd = &sc.cmds[i];
+        struct token *toks = cmd->toks;
+        int ntok = cmd->ntok;
+        bool builtin = cmd->builtin;
+        
+        arena_reset(&arena);
+        jobs_notify();
+        if(cmd->deferred){
+            /* Expand $VAR now that the earlier lines have run */
+            const char *p = cmd->text;
+            toks = line_toks;
+            ntok = lex_command(toks, SCRIPT_TOKENS_MAX, &p, &arena);
+            if(ntok <= 0){
+                status = ntok == 0 ? 0 : 2 << 8;
+                continue;
             }
+            builtin = toks[0].type == TOKEN_WORD && is_line_builtin(toks[0].text);
         }
-        else{
-            struct passwd *pw = getpwuid(getuid());
-            const char *home = pw->pw_dir;
-            if (chdir(home)!=0)
-            {
-                perror("chdir");
-                
-            }
-            
+        
+        status = 0;
+        if(builtin){
+            customargs(toks, &ntok);
+            continue;
         }
-        return 0;
-    }
-    if(strcmp(args[0], "exit") == 0) {
-        free(ptr2);
-        free(ptr3);
-        exit(0);
-        return -1;
-     }
-    if(strcmp(args[0],"setenv") ==0){
-        if(args[2] != NULL){
-            setenv(args[1], args[2], true);
+        if(cmd->list != NULL){
+            status = run_commands(cmd->list);
+        }else{
+            status = execute(toks, ntok, &arena);
         }
-        return 0;
+        export_pipestatus();
     }
-    return 0;
+    script_free(&sc);
+    return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
 }
 
-
 /**
  * Main Function which initializes the shell
+ * @param argc - number of arguments
+ * @param argv - "-f script" runs a script instead of reading commands
  */
 
-int main(void)
+int main(int argc, char *argv[])
 {
+    char *script = NULL;
+    int opt;
+    
+    while((opt = getopt(argc, argv, "f:")) != -1){
+        if(opt == 'f'){
+            script = optarg;
+        }else{
+            fprintf(stderr, "usage: %s [-f script]\n", argv[0]);
+            return 2;
+        }
+    }
+    
+    prompt_init();
+    profile_open(getenv("CRASH_PROFILE"));
     signal(SIGINT, sigint_handler);
     signal(SIGTERM, sigint_handler);
-
+    
     LOGP("Initializing shell\n");
+    char *launch = getenv("CRASH_LAUNCH");
+    if (launch != NULL && strcmp(launch, "fork") == 0) {
+        spawn_enabled = false;
+    }
+    LOG("Launching commands with %s\n", spawn_enabled ? "posix_spawn" : "fork");
+    jobs_init(script == NULL && isatty(STDIN_FILENO));
     char *locale = setlocale(LC_ALL, "en_US.UTF-8");
     LOG("Setting locale: %s\n",
         (locale != NULL) ? locale : "could not set locale!");
+    
+    arena_init(&arena, ARENA_CHUNK_SZ);
+    if(script != NULL){
+        history_open(NULL, 0); // for "history" and "!N" in the script
+        int rv = run_script(script);
+        arena_free(&arena);
+        history_close();
+        return rv;
+    }
+    
+    /* Only an interactive shell keeps its history in the history file */
+    char *histsize = getenv("CRASH_HISTSIZE");
+    char *histfile = getenv("CRASH_HISTFILE");
+    char histpath[PATH_MAX];
+    if(histfile == NULL && getenv("HOME") != NULL){
+        snprintf(histpath, sizeof(histpath), "%s/.crash_history", getenv("HOME"));
+        histfile = histpath;
+    }
+    history_open(isatty(STDIN_FILENO) ? histfile : NULL,
+                 histsize != NULL ? strtoul(histsize, NULL, 10) : 0);
+    
+    size_t line_sz = 0;
     while(true) {
+        /* Background jobs that finished since the last prompt */
+        jobs_notify();
         if (isatty(STDIN_FILENO)) {
+            cmnd = history_next(); // other shells may have added to the history
             print_prompt(cmnd, status);
         }
-        char *line = NULL;
-        char *line_ptr = NULL;
-        char *args[ARG_MAX];
-        char *ptr = NULL;
-        size_t line_sz;
+        struct token toks[ARG_MAX];
         
-        if(getline(&line, &line_sz, stdin) == -1) {
-            free(line);
+        /* Everything from the previous command is released at once */
+        arena_reset(&arena);
+        if((isatty(STDIN_FILENO) ? lineedit_read(&line, &line_sz, redraw_prompt)
+                                 : getline(&line, &line_sz, stdin)) == -1) {
             break;
         }
-
+    
         LOG("read line from stdin: %s", line);
         //TOKENIZE ARGS
         int numCmnds;
-        numCmnds = tokenize_args(args, line, line_sz, line_ptr);
+        numCmnds = lex_line(toks, ARG_MAX, line, &arena);
         
         //EMPTY ARG CHECK
-        if(args[0] == 0)
+        if(numCmnds == 0)
         {
             continue;
         }
-        if(numCmnds == 0)
+        if(numCmnds == -1)
         {
+            add_entry(line);
+            status = 2 << 8; // syntax error
             continue;
         }
         
         //CHECK IF BUILT-IN
-        customargs(args, &numCmnds, line_sz, line_ptr, line);
-        free(line_ptr);
+        status = 0;
+        int builtin = customargs(toks, &numCmnds);
         //ADD COMMAND TO HISTORY
         if(!entry_hold){
-            add_entry(cmnd++, line);
+            add_entry(line);
         }else{
             entry_hold = false;
         }
         
-        pid_t child = fork();
-        if(child == -1)
-        {
-            perror("fork");
-        }
-        else if(child == 0)
-        {
-            /* Were the child!*/
-            execute(args, numCmnds);
-            close(STDOUT_FILENO);
-            close(STDIN_FILENO);
-        }
-        else//the parent
-        {
-            waitpid(child, &status, 0);
-            
-        }
-        free(line);
-        free(line_ptr);
-        free(ptr);
-
-        if(args[0] != NULL){
-            free(args[0]);
+        if(builtin != 1 && numCmnds > 0){
+            /* Every stage is launched from here; foreground ones are waited for */
+            status = execute(toks, numCmnds, &arena);
+            export_pipestatus();
         }
         
-
+    
     }
+    free(line);
+    arena_free(&arena);
+    history_close();
     return 0;
 }
 
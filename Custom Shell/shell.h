@@ -0,0 +1,13 @@
+/**
+* @file shell.h
+* @author Ghufran Latif
+* @date 16 Oct. 2026
+* @Header file for shell.c, for the builtins that change the shell itself
+*/
+#ifndef _SHELL_H_
+#define _SHELL_H_
+
+void prompt_update_cwd();
+void shell_exit(int code);
+
+#endif
@@ -0,0 +1,150 @@
+/**
+* @file strsearch.c
+* @author Ghufran Latif
+* @date 16 Oct. 2026
+* @Substring search used to search the history. Candidates are found 16
+ * (SSE2) or 32 (AVX2) positions at a time by comparing both the first and
+ * the last byte of the pattern, which rules out nearly every position
+ * before a memcmp is needed. The kernel is picked once, from what the CPU
+ * supports; other CPUs use the plain loop.
+*/
+#include "strsearch.h"
+
+#include <stdio.h>
+
+#include "debug.h"
+
+#include <string.h>
+
+#include <stdbool.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define STRSEARCH_X86 1
+#include <immintrin.h>
+#endif
+
+typedef const char *(*rfind_fn)(const char *hay, size_t n, const char *needle, size_t k);
+
+/**
+ * Finds the last occurrence of a pattern, one position at a time
+ * @param hay - bytes to search
+ * @param n - number of bytes
+ * @param needle - the pattern
+ * @param k - its length, at least 1
+ * @return - start of the last occurrence, or NULL
+ */
+static const char *rfind_scalar(const char *hay, size_t n, const char *needle, size_t k)
+{
+    if (k > n) {
+        return NULL;
+    }
+    for (size_t i = n - k + 1; i-- > 0; ) {
+        if (hay[i] == needle[0] && memcmp(hay + i, needle, k) == 0) {
+            return hay + i;
+        }
+    }
+    return NULL;
+}
+
+#ifdef STRSEARCH_X86
+/**
+ * Same as rfind_scalar, 16 positions at a time
+ */
+static const char *rfind_sse2(const char *hay, size_t n, const char *needle, size_t k)
+{
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[k - 1]);
+    size_t i;
+    
+    if (k > n) {
+        return NULL;
+    }
+    /* Positions [i - 16, i) read bytes up to i + k - 2, which is < n */
+    for (i = n - k + 1; i >= 16; ) {
+        i -= 16;
+        __m128i a = _mm_loadu_si128((const __m128i *) (hay + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (hay + i + k - 1));
+        unsigned int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first),
+                                                            _mm_cmpeq_epi8(b, last)));
+        while (mask != 0) {
+            int bit = 31 - __builtin_clz(mask);
+            if (memcmp(hay + i + bit, needle, k) == 0) {
+                return hay + i + bit;
+            }
+            mask &= ~(1U << bit);
+        }
+    }
+    return rfind_scalar(hay, i + k - 1, needle, k);
+}
+
+/**
+ * Same as rfind_scalar, 32 positions at a time
+ */
+__attribute__((target("avx2")))
+static const char *rfind_avx2(const char *hay, size_t n, const char *needle, size_t k)
+{
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[k - 1]);
+    size_t i;
+    
+    if (k > n) {
+        return NULL;
+    }
+    for (i = n - k + 1; i >= 32; ) {
+        i -= 32;
+        __m256i a = _mm256_loadu_si256((const __m256i *) (hay + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *) (hay + i + k - 1));
+        unsigned int mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first),
+                                                                  _mm256_cmpeq_epi8(b, last)));
+        while (mask != 0) {
+            int bit = 31 - __builtin_clz(mask);
+            if (memcmp(hay + i + bit, needle, k) == 0) {
+                return hay + i + bit;
+            }
+            mask &= ~(1U << bit);
+        }
+    }
+    return rfind_sse2(hay, i + k - 1, needle, k);
+}
+#endif
+
+static rfind_fn kernel = NULL;
+
+/**
+ * Picks the fastest kernel the CPU supports
+ */
+static void pick_kernel()
+{
+    const char *name;
+    
+#ifdef STRSEARCH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernel = rfind_avx2;
+        name = "avx2";
+    } else {
+        kernel = rfind_sse2;
+        name = "sse2";
+    }
+#else
+    kernel = rfind_scalar;
+    name = "scalar";
+#endif
+    LOG("Substring search uses the %s kernel\n", name);
+}
+
+/**
+ * Finds the last occurrence of a pattern in a span of bytes
+ * @param hay - bytes to search
+ * @param n - number of bytes
+ * @param needle - the pattern
+ * @param k - its length, at least 1
+ * @return - start of the last occurrence, or NULL
+ */
+const char *str_rfind(const char *hay, size_t n, const char *needle, size_t k)
+{
+    if (kernel == NULL) {
+        pick_kernel();
+    }
+    return kernel(hay, n, needle, k);
+}
@@ -0,0 +1,13 @@
+/**
+* @file strsearch.h
+* @author Ghufran Latif
+* @date 16 Oct. 2026
+* @Header file for strsearch.c, the vectorized substring search
+*/
+#ifndef _STRSEARCH_H_
+#define _STRSEARCH_H_
+#include <stddef.h>
+
+const char *str_rfind(const char *hay, size_t n, const char *needle, size_t k);
+
+#endif
@@ -1,5 +1,5 @@
 /**
-* @file shell.c
+* @file tokenizer.c
 * @author Ghufran Latif
 * @date 1 Nov. 2019
 * @Used to tokenize all the commands entered in the shell and parse according to delimeters
@@ -21,6 +21,8 @@
 #include <unistd.h>
 
 #include <stddef.h>
+
+#include <ctype.h>
 /**
  * Retrieves the next token from a string.
  *
@@ -77,45 +79,351 @@ char *next_token(char **str_ptr, const char *delim)
 
 
 /**
- * Calls the next _token function to tokenize given specific parameters
- * and add to the argument array.
- * @param char*args[] - argument array to update
- * @param char*line - line to be tokenized
- * @return - returns the length of the argument array
+ * Characters that end a run of plain word characters
  */
-int tokenize_args(char *args[], char *line, size_t line_sz, char* line_ptr)
-{
-    line_ptr = strndup(line, line_sz);
-    int tokens = 0;
-    char *next_tok = line_ptr;
-    char *curr_tok;
-    /* Tokenize. Note that ' ,?!' will all be removed. */
-    while ((curr_tok = next_token(&next_tok, " \t\n\r")) != NULL && tokens < 4096) {
-        if(strstr(curr_tok, "#") != NULL )
-        {
-            break;
-        }
-        if(curr_tok[0] == '$'){
-            char* line1 = next_token(&line1, "$\n");// moves point to after $
+static const unsigned char word_stop[256] = {
+    ['\0'] = 1, [' '] = 1, ['\t'] = 1, ['\r'] = 1, ['\n'] = 1,
+    ['|'] = 1, ['&'] = 1, [';'] = 1, ['<'] = 1, ['>'] = 1,
+    ['\''] = 1, ['"'] = 1, ['\\'] = 1, ['$'] = 1,
+};
 
-            curr_tok = getenv(line1);
-          }
-        args[tokens++] = curr_tok;
+/**
+ * Spelling of each operator, indexed by enum token_op
+ */
+static const char *op_text[] = {
+    [OP_PIPE] = "|", [OP_IN] = "<", [OP_OUT] = ">", [OP_APPEND] = ">>",
+    [OP_ERR_OUT] = "2>", [OP_ERR_APPEND] = "2>>", [OP_ERR_TO_OUT] = "2>&1",
+    [OP_ALL_OUT] = "&>", [OP_SEMI] = ";", [OP_BACKGROUND] = "&",
+    [OP_AND] = "&&", [OP_OR] = "||",
+};
 
-    }
-    args[tokens] = 0;
-    
-    if(tokens < 4096){
-        return tokens;
-    }else{
-        free(line_ptr);
-        return 0;
+/**
+ * Characters that end a word when they are not quoted
+ */
+static const unsigned char word_end[256] = {
+    ['\0'] = 1, [' '] = 1, ['\t'] = 1, ['\r'] = 1, ['\n'] = 1,
+    ['|'] = 1, ['&'] = 1, [';'] = 1, ['<'] = 1, ['>'] = 1,
+};
+
+/**
+ * Recognizes the operator at the start of a token, longest match first
+ * @param p - start of the token
+ * @return - the operator, or OP_NONE if a word starts here
+ */
+static enum token_op match_operator(const char *p)
+{
+    switch (*p) {
+        case '|':
+            return p[1] == '|' ? OP_OR : OP_PIPE;
+        case '&':
+            return p[1] == '&' ? OP_AND : p[1] == '>' ? OP_ALL_OUT : OP_BACKGROUND;
+        case ';':
+            return OP_SEMI;
+        case '<':
+            return OP_IN;
+        case '>':
+            return p[1] == '>' ? OP_APPEND : OP_OUT;
+        case '2':
+            if (p[1] != '>') {
+                return OP_NONE;
+            }
+            if (p[2] == '>') {
+                return OP_ERR_APPEND;
+            }
+            return p[2] == '&' && p[3] == '1' ? OP_ERR_TO_OUT : OP_ERR_OUT;
+        default:
+            return OP_NONE;
     }
 }
 
+/**
+ * States of the word lexer
+ */
+enum lex_state {
+    LEX_WORD,           // unquoted
+    LEX_SQUOTE,         // inside '...': everything is literal
+    LEX_DQUOTE,         // inside "...": only $ and some \ escapes are special
+};
 
+/* Scratch buffer a word is assembled in before it is copied to the arena */
+static char *scratch = NULL;
+static size_t scratch_len = 0;
+static size_t scratch_cap = 0;
 
+/**
+ * Appends bytes to the word being assembled
+ * @param src - bytes to append
+ * @param n - number of bytes
+ * @return - 0 on success, -1 on error
+ */
+static int emit(const char *src, size_t n)
+{
+    if (scratch_len + n + 1 > scratch_cap) {
+        size_t new_cap = scratch_cap == 0 ? 4096 : scratch_cap;
+        while (new_cap < scratch_len + n + 1) {
+            new_cap *= 2;
+        }
+        char *grown = realloc(scratch, new_cap);
+        if (grown == NULL) {
+            perror("realloc");
+            return -1;
+        }
+        scratch = grown;
+        scratch_cap = new_cap;
+    }
+    memcpy(scratch + scratch_len, src, n);
+    scratch_len += n;
+    return 0;
+}
 
+/**
+ * Expands $NAME or ${NAME} into the word being assembled. A '$' that does
+ * not start a variable name is kept as it is.
+ * @param p - points at the '$'
+ * @param expanded - set when a variable was expanded
+ * @return - the position after the expansion
+ */
+static const char *expand_var(const char *p, bool *expanded)
+{
+    const char *name = p + 1;
+    bool braces = *name == '{';
+    size_t len = 0;
+    char buf[256];
+    char *value;
+    
+    if (braces) {
+        name++;
+    }
+    while (name[len] == '_' || isalpha((unsigned char) name[len])
+           || (len > 0 && isdigit((unsigned char) name[len]))) {
+        len++;
+    }
+    if (len == 0 || len >= sizeof(buf) || (braces && name[len] != '}')) {
+        emit("$", 1);
+        return p + 1;
+    }
+    
+    memcpy(buf, name, len);
+    buf[len] = '\0';
+    value = getenv(buf);
+    if (value != NULL) {
+        emit(value, strlen(value));
+    }
+    *expanded = true;
+    return name + len + (braces ? 1 : 0);
+}
+
+/**
+ * Lexes one word with a small state machine: quotes are removed, escapes
+ * resolved and variables expanded as the input is read.
+ * @param p - start of the word
+ * @param tok - token to fill in
+ * @param arena - arena that gets the finished word
+ * @return - the position after the word, or NULL on a syntax error
+ */
+static const char *lex_word(const char *p, struct token *tok, struct arena *arena)
+{
+    enum lex_state state = LEX_WORD;
+    bool quoted = false;
+    bool expanded = false;
+    const char *run = p;
+    
+    /* Fast path: a word without quotes, escapes or $ is copied straight
+     * from its span */
+    while (!word_stop[(unsigned char) *run]) {
+        run++;
+    }
+    if (word_end[(unsigned char) *run]) {
+        tok->type = TOKEN_WORD;
+        tok->op = OP_NONE;
+        tok->len = run - p;
+        tok->text = arena_alloc(arena, tok->len + 1);
+        if (tok->text == NULL) {
+            return NULL;
+        }
+        memcpy(tok->text, p, tok->len);
+        tok->text[tok->len] = '\0';
+        return run;
+    }
+    
+    scratch_len = 0;
+    while (true) {
+        char c = *p;
+        
+        if (state == LEX_WORD) {
+            const char *run = p;
+            /* Copy plain characters in one go */
+            while (!word_stop[(unsigned char) *p]) {
+                p++;
+            }
+            if (p > run) {
+                emit(run, p - run);
+                continue;
+            }
+            if (word_end[(unsigned char) c]) {
+                break;
+            }
+            if (c == '\'') {
+                state = LEX_SQUOTE;
+                quoted = true;
+                p++;
+            } else if (c == '"') {
+                state = LEX_DQUOTE;
+                quoted = true;
+                p++;
+            } else if (c == '\\') {
+                if (p[1] != '\0' && p[1] != '\n') {
+                    emit(p + 1, 1);
+                }
+                p += p[1] != '\0' ? 2 : 1;
+            } else { // '$'
+                p = expand_var(p, &expanded);
+            }
+        } else if (state == LEX_SQUOTE) {
+            const char *end = strchr(p, '\'');
+            if (end == NULL) {
+                fprintf(stderr, "crash: syntax error: unterminated '\n");
+                return NULL;
+            }
+            emit(p, end - p);
+            p = end + 1;
+            state = LEX_WORD;
+        } else { // LEX_DQUOTE
+            if (c == '\0') {
+                fprintf(stderr, "crash: syntax error: unterminated \"\n");
+                return NULL;
+            } else if (c == '"') {
+                state = LEX_WORD;
+                p++;
+            } else if (c == '\\' && (p[1] == '"' || p[1] == '\\' || p[1] == '$' || p[1] == '`')) {
+                emit(p + 1, 1);
+                p += 2;
+            } else if (c == '$') {
+                p = expand_var(p, &expanded);
+            } else {
+                emit(p, 1);
+                p++;
+            }
+        }
+    }
+    
+    tok->type = TOKEN_WORD;
+    tok->op = OP_NONE;
+    tok->len = p - tok->start;
+    tok->text = NULL;
+    if (scratch_len == 0 && expanded && !quoted) {
+        /* Unquoted expansions of unset variables disappear entirely */
+        return p;
+    }
+    tok->text = arena_alloc(arena, scratch_len + 1);
+    if (tok->text == NULL) {
+        return NULL;
+    }
+    memcpy(tok->text, scratch, scratch_len);
+    tok->text[scratch_len] = '\0';
+    return p;
+}
 
+/**
+ * Splits one command line into typed tokens in a single pass. Words keep a
+ * span into the input and get their final value (quotes removed, escapes
+ * resolved, $VAR expanded) in the arena. The line ends at a newline (which
+ * may still appear inside quotes) or at the NUL ending the input. A '#' at
+ * the start of a word comments out the rest of the line.
+ * @param toks - array to fill
+ * @param max - capacity of toks
+ * @param pos - start of the line (left untouched); moved past its newline,
+ *              also on a syntax error, so the next call lexes the next line
+ * @param arena - per-command arena that owns the word values
+ * @return - the number of tokens, or -1 on a syntax error
+ */
+int lex_command(struct token toks[], int max, const char **pos, struct arena *arena)
+{
+    const char *p = *pos;
+    int n = 0;
+    
+    while (true) {
+        enum token_op op;
+        
+        while (*p == ' ' || *p == '\t' || *p == '\r') {
+            p++;
+        }
+        if (*p == '#') {
+            p += strcspn(p, "\n");
+        }
+        if (*p == '\n') {
+            p++;
+            break;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        if (n == max) {
+            fprintf(stderr, "crash: too many arguments\n");
+            n = -1;
+            break;
+        }
+        
+        toks[n].start = p;
+        op = match_operator(p);
+        if (op != OP_NONE) {
+            toks[n].type = op == OP_PIPE ? TOKEN_PIPE
+                : op >= OP_SEMI ? TOKEN_SEPARATOR : TOKEN_REDIRECT;
+            toks[n].op = op;
+            toks[n].text = (char *) op_text[op];
+            toks[n].len = strlen(op_text[op]);
+            p += toks[n].len;
+            n++;
+            continue;
+        }
+        
+        p = lex_word(p, &toks[n], arena);
+        if (p == NULL) {
+            n = -1;
+            break;
+        }
+        if (toks[n].text != NULL) {
+            n++;
+        }
+    }
+    if (n == -1) {
+        /* Carry on after the newline of the line the error is on */
+        p = strchr(*pos, '\n');
+        p = p != NULL ? p + 1 : *pos + strlen(*pos);
+    }
+    *pos = p;
+    return n;
+}
 
+/**
+ * Splits a command line into typed tokens, see lex_command
+ * @param toks - array to fill
+ * @param max - capacity of toks
+ * @param line - line to lex (left untouched)
+ * @param arena - per-command arena that owns the word values
+ * @return - the number of tokens, or -1 on a syntax error
+ */
+int lex_line(struct token toks[], int max, const char *line, struct arena *arena)
+{
+    return lex_command(toks, max, &line, arena);
+}
 
+/**
+ * Collects the words of the first command (up to the first operator) into
+ * a NULL terminated argument array, e.g. for the builtins
+ * @param toks - tokens from lex_line
+ * @param ntok - number of tokens
+ * @param argv - array to fill
+ * @param max - capacity of argv, including the terminating NULL
+ * @return - the number of words
+ */
+int token_argv(struct token toks[], int ntok, char *argv[], int max)
+{
+    int argc = 0;
+    
+    for (int i = 0; i < ntok && argc < max - 1 && toks[i].type == TOKEN_WORD; i++) {
+        argv[argc++] = toks[i].text;
+    }
+    argv[argc] = NULL;
+    return argc;
+}
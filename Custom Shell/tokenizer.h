@@ -8,8 +8,53 @@
 #ifndef _TOKENIZER_H_
 #define _TOKENIZER_H_
 
+#include "arena.h"
+
+/**
+ * Kinds of tokens produced by lex_line
+ */
+enum token_type {
+    TOKEN_WORD,
+    TOKEN_PIPE,         // |
+    TOKEN_REDIRECT,     // < > >> 2> 2>> 2>&1 &>
+    TOKEN_SEPARATOR,    // ; & && ||
+};
+
+/**
+ * Which operator a TOKEN_PIPE, TOKEN_REDIRECT or TOKEN_SEPARATOR is
+ */
+enum token_op {
+    OP_NONE,            // words
+    OP_PIPE,            // |
+    OP_IN,              // <
+    OP_OUT,             // >
+    OP_APPEND,          // >>
+    OP_ERR_OUT,         // 2>
+    OP_ERR_APPEND,      // 2>>
+    OP_ERR_TO_OUT,      // 2>&1
+    OP_ALL_OUT,         // &>
+    OP_SEMI,            // ;
+    OP_BACKGROUND,      // &
+    OP_AND,             // &&
+    OP_OR,              // ||
+};
+
+/**
+ * One token of a command line
+ */
+struct token {
+    enum token_type type;
+    enum token_op op;
+    const char *start;  // span of the token in the input line
+    size_t len;
+    char *text;         // words: value after quote removal and $VAR expansion
+                        // operators: the operator itself
+};
+
 char *next_token(char **str_ptr, const char *delim);
-int tokenize_args(char *args[], char *line, size_t line_sz, char *line_ptr);
+int lex_command(struct token toks[], int max, const char **pos, struct arena *arena);
+int lex_line(struct token toks[], int max, const char *line, struct arena *arena);
+int token_argv(struct token toks[], int ntok, char *argv[], int max);
 
 
 #endif
@@ -0,0 +1,149 @@
+/**
+ * @file
+ *
+ * CPU utilization sampler implementation. /proc/stat holds counters that only
+ * grow, so utilization is always the difference between two samples.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "debug.h"
+
+/**
+ * Prepares an empty sample.
+ * @param struct cpu_sample *s - sample to initialize
+ */
+void cpu_sample_init(struct cpu_sample *s) {
+    memset(s, 0, sizeof(*s));
+    s->total.id = -1;
+}
+
+/**
+ * Parses the counters that follow the label of a cpu line.
+ * @param char *fields - text after the label (modified in place)
+ * @param struct cpu_times *t - counters to fill in
+ */
+static void parse_times(char *fields, struct cpu_times *t) {
+    unsigned long long *dest[] = {
+        &t->user, &t->nice, &t->system, &t->idle,
+        &t->iowait, &t->irq, &t->softirq, &t->steal,
+    };
+    size_t ndest = sizeof(dest) / sizeof(dest[0]);
+    char *curr_tok;
+
+    for (size_t i = 0; i < ndest; ++i) {
+        curr_tok = next_token(&fields, " ");
+        *dest[i] = curr_tok != NULL ? strtoull(curr_tok, NULL, 10) : 0;
+    }
+}
+
+/**
+ * Reads the aggregate and per-core counters from /proc/stat.
+ * @param struct cpu_sample *s - sample to fill in
+ * @param struct proc_buf *pb - buffer to read the file with
+ *
+ * @return 0 on success, -1 on error
+ */
+int cpu_sample_read(struct cpu_sample *s, struct proc_buf *pb) {
+    if (pb_load(pb, "stat") <= 0) {
+        return -1;
+    }
+    return cpu_sample_parse(s, pb);
+}
+
+/**
+ * Parses the aggregate and per-core counters out of /proc/stat contents that
+ * have already been loaded (e.g. by pf_read).
+ * @param struct cpu_sample *s - sample to fill in
+ * @param struct proc_buf *pb - buffer holding /proc/stat
+ *
+ * @return 0 on success, -1 on error
+ */
+int cpu_sample_parse(struct cpu_sample *s, struct proc_buf *pb) {
+    char *line;
+
+    s->ncores = 0;
+    while ((line = pb_next_line(pb)) != NULL) {
+        char *label;
+        char *fields = line;
+
+        if (strncmp(line, "cpu", 3) != 0) {
+            /* The cpu lines come first; nothing else is needed. */
+            break;
+        }
+        label = next_token(&fields, " ");
+        if (label == NULL) {
+            continue;
+        }
+
+        if (strcmp(label, "cpu") == 0) {
+            parse_times(fields, &s->total);
+            continue;
+        }
+
+        if (s->ncores == s->cap) {
+            int new_cap = s->cap == 0 ? 16 : s->cap * 2;
+            struct cpu_times *grown = realloc(s->cores,
+                    new_cap * sizeof(struct cpu_times));
+            if (grown == NULL) {
+                perror("realloc");
+                return -1;
+            }
+            s->cores = grown;
+            s->cap = new_cap;
+        }
+        s->cores[s->ncores].id = atoi(label + 3);
+        parse_times(fields, &s->cores[s->ncores]);
+        s->ncores++;
+    }
+    return 0;
+}
+
+/**
+ * Releases the per-core storage of a sample.
+ * @param struct cpu_sample *s - sample to free
+ */
+void cpu_sample_free(struct cpu_sample *s) {
+    free(s->cores);
+    cpu_sample_init(s);
+}
+
+/**
+ * Returns the increase of a counter, or 0 if it went backwards.
+ */
+static double delta(unsigned long long before, unsigned long long after) {
+    return after > before ? (double) (after - before) : 0;
+}
+
+/**
+ * Computes the utilization of one cpu line between two samples.
+ * @param const struct cpu_times *before - earlier sample
+ * @param const struct cpu_times *after - later sample
+ * @param struct cpu_usage *usage - utilization breakdown to fill in
+ */
+void cpu_usage_between(const struct cpu_times *before,
+        const struct cpu_times *after, struct cpu_usage *usage) {
+    double user = delta(before->user, after->user)
+        + delta(before->nice, after->nice);
+    double system = delta(before->system, after->system);
+    double idle = delta(before->idle, after->idle);
+    double iowait = delta(before->iowait, after->iowait);
+    double irq = delta(before->irq, after->irq)
+        + delta(before->softirq, after->softirq);
+    double steal = delta(before->steal, after->steal);
+    double total = user + system + idle + iowait + irq + steal;
+
+    memset(usage, 0, sizeof(*usage));
+    if (total <= 0 || before->id != after->id) {
+        return;
+    }
+    usage->user = user / total;
+    usage->system = system / total;
+    usage->iowait = iowait / total;
+    usage->irq = irq / total;
+    usage->steal = steal / total;
+    usage->busy = (user + system + irq + steal) / total;
+}
@@ -0,0 +1,56 @@
+/**
+ * @file
+ *
+ * CPU utilization sampler built on the cpu and cpuN lines of /proc/stat.
+ */
+
+#ifndef _CPU_H_
+#define _CPU_H_
+
+#include "procfs.h"
+
+/**
+ * Cumulative time counters of one cpu line, in clock ticks.
+ */
+struct cpu_times {
+    int id;                 /**< Core number, or -1 for the aggregate line */
+    unsigned long long user;
+    unsigned long long nice;
+    unsigned long long system;
+    unsigned long long idle;
+    unsigned long long iowait;
+    unsigned long long irq;
+    unsigned long long softirq;
+    unsigned long long steal;
+};
+
+/**
+ * One reading of /proc/stat.
+ */
+struct cpu_sample {
+    struct cpu_times total;
+    struct cpu_times *cores;
+    int ncores;
+    int cap;
+};
+
+/**
+ * Utilization between two samples, as fractions of the elapsed time.
+ */
+struct cpu_usage {
+    double busy;            /**< Everything except idle and iowait */
+    double user;            /**< user + nice */
+    double system;
+    double iowait;
+    double irq;             /**< irq + softirq */
+    double steal;
+};
+
+void cpu_sample_init(struct cpu_sample *s);
+int cpu_sample_read(struct cpu_sample *s, struct proc_buf *pb);
+int cpu_sample_parse(struct cpu_sample *s, struct proc_buf *pb);
+void cpu_sample_free(struct cpu_sample *s);
+void cpu_usage_between(const struct cpu_times *before,
+        const struct cpu_times *after, struct cpu_usage *usage);
+
+#endif
@@ -14,29 +14,65 @@
 #include <limits.h>
 #include <math.h>
 #include <pwd.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 #include <errno.h>
 
+#include "cpu.h"
 #include "debug.h"
+#include "output.h"
+#include "procfs.h"
+#include "series.h"
+#include "tasks.h"
 
 #define BUF_SZ 1024
 
+/* Default window between the two samples of CPU usage, in ms */
+#define DEFAULT_SAMPLE_MS 200
+
+/* Default time between live view refreshes, in ms (-w overrides it) */
+#define LIVE_INTERVAL_MS 1000
+
+/* Default number of samples kept by the daemon (-N overrides it) */
+#define DAEMON_SAMPLES 3600
+
+
+/**
+ * Memory totals read from meminfo, in kB.
+ */
+struct mem_info {
+    double total_kb;
+    double used_kb;
+};
+
 
 /* Function prototypes */
 void print_usage(char *argv[]);
 void get_uptime(double num[2]);
-int read_line(char *str, size_t, int fd);
 void print_uptime();
-double cpu_usage();
+int cpu_usage(struct cpu_sample *before, struct cpu_sample *after, long window_ms);
+int print_cpu_usage(const struct cpu_sample *before, const struct cpu_sample *after);
+void percentage_bar(double percentage);
 void loadavg();
-char *trimwhitespace(char *str);
+void print_loadavg(struct proc_buf *pb);
+void parse_loadavg(struct proc_buf *pb, double load[3]);
+double mem_usage(struct mem_info *mem);
+double parse_meminfo(struct proc_buf *pb, struct mem_info *mem);
+int get_cpuinfo(char* model_name, size_t sz);
+void get_hostname(char* buf, size_t sz);
+int get_kernel(char* buf, size_t sz);
 void taskcount();
+void num_process(int jobs, enum task_sort sort_by, size_t limit, long window_ms);
+void print_task_header();
+void print_task_row(const struct task_row *row);
 char* itoa(int i, char b[]);
 
 
@@ -52,90 +88,6 @@ struct view_opts {
 };
 
 
-/**
- * Returns index of the first occurence of the delimeter
- * @param char* str1 - string to be read from
- * @param char* delm - delimeter to look for
- *
- *@return index of the first occurence of the delimeter
- */
-int get_index(char* str1, char* delm){
-    return strcspn(str1, delm);
-}
-
-/**
- * Tokenizer functions breaks up given string
- * according to the delimeter and saves it in
- * a pointer list and returns the size of the list
- * so the list can be iterated
- * @param char* retval[] - list to add the tokens
- * @param char* str1 - string to be tokenized
- * @param char* delm - delimeter
- *
- * @return the size of retval
- */
-int tokenize(char* retval[], char* str1, char* delm){
-    //    char* retval[BUF_SZ];
-    int rv = 0;
-    int n = get_index(str1, delm);          //get index at end of string
-    
-    while(n != strlen(str1)){               // keep iterating until the index matches end of string
-        
-        
-        char* temp = malloc((n+1)*sizeof(*temp));           //allocate size for the first string
-        int i;
-        for(i = 0; i < n; i++) {            //copy string into temp value;
-            temp[i] = str1[i];
-        }
-        temp[i] = '\0';
-        char* temp2 = malloc((strlen(str1) - n+1)*sizeof(*temp2));          // allocate size of the rest of string for new variable
-        for(int j = n+1, k = 0;  j < strlen(str1)+1; j++, k++){             // copy the remmaining string into a temporary variable to later manipulate the orginal string
-            temp2[k] = str1[j];
-        }
-        retval[rv++] = temp;            // save the tokenized word( converted to floats) into a list we will return
-        str1 = temp2;                   // Shorten str1 so the while loop runs for the rest of the string
-        n = get_index(str1, delm);      // update the new starting index using the length of the next word
-        
-    }
-    retval[rv++] = str1; // save the last value of the string to our return list.
-    
-    return rv;
-    
-}
-
-/**
- * Reads one line of a file given File descriptor
- * @param char *str - the line that needs to be reade
- * @param size_t size - size of Buffer
- * @param int fd - the file desrciptor
- *
- * @return the size of line
- */
-int read_line(char *str, size_t size, int fd) {
-    
-    int total = 0;
-    char t;
-    while (read(fd, &t, 1) > 0 ) { // if read is zero it is EOF
-        
-        *(str + total) = t;
-        ++total;
-        
-        if((total + 2) > size){
-            *(str + total) = '\0';
-            return total;
-        }
-        
-        if(t == '\n' ){
-            break;
-        }
-        
-        
-    }
-    *(str + total - 1) = '\0';
-    return total;
-    
-}
-
 /**
  * Prints help/program usage information.
  *
@@ -144,34 +96,88 @@ int read_line(char *str, size_t size, int fd) {
  */
 void print_usage(char *argv[])
 {
-    printf("Usage: %s [-ahrst] [-l] [-p procfs_dir]\n" , argv[0]);
+    printf("Usage: %s [-ahrst] [-l] [-j jobs] [-n count] [-S cpu|mem] [-w ms] [-o text|json|csv] [-p procfs_dir]\n"
+           "       %s -d interval_ms [-N samples] [-f file] [-o csv|bin] [-p procfs_dir]\n" , argv[0], argv[0]);
     printf("\n");
     printf("Options:\n"
            "    * -a              Display all (equivalent to -rst, default)\n"
+           "    * -d interval_ms  Headless daemon: sample CPU, memory, load and task count\n"
+           "                      every interval_ms into a ring buffer. The ring is dumped\n"
+           "                      on SIGUSR1 and on SIGINT/SIGTERM (before exiting).\n"
+           "    * -f file         Daemon dump file, replaced on every dump (default: stdout)\n"
            "    * -h              Help/usage information\n"
-           "    * -l              Live view. Cannot be used with other view options.\n"
+           "    * -j jobs         Threads used to scan the task list (default: online CPUs)\n"
+           "    * -l              Live view. Cannot be used with other view options,\n"
+           "                      except -t to add a live task table.\n"
+           "    * -n count        Only show the first count tasks of the task list\n"
+           "    * -N samples      Number of samples the daemon keeps (default: 3600)\n"
+           "    * -o format       Output format: text (default), json or csv.\n"
+           "                      Live view streams one JSON object or CSV row per tick.\n"
+           "                      Daemon dumps are csv (default) or bin.\n"
            "    * -p procfs_dir   Change the expected procfs mount point (default: /proc)\n"
            "    * -r              Hardware Information\n"
            "    * -s              System Information\n"
-           "    * -t              Task Information\n");
+           "    * -S cpu|mem      Sort the task list by CPU usage or resident memory\n"
+           "    * -t              Task Information\n"
+           "    * -w ms           CPU usage sampling window (default: 200 ms),\n"
+           "                      or live view refresh interval (default: 1000 ms)\n");
     printf("\n");
     
 }
 
+/**
+ * Reads the kernel version from
+ * the version file
+ * @param char* buf - destination for the version
+ * @param size_t sz - size of buf
+ *
+ * @return 0 on success, -1 if it could not be read
+ */
+int get_kernel(char* buf, size_t sz){
+    struct proc_buf pb;
+    char* kernel;
+    char* smallList[3];
+    int rv = -1;
+    
+    buf[0] = '\0';
+    pb_init(&pb);
+    pb_load(&pb, "version");
+    kernel = pb_next_line(&pb);
+    if (kernel != NULL && tokenize(smallList, 3, kernel, " ") == 3) {
+        snprintf(buf, sz, "%s", smallList[2]);
+        rv = 0;
+    }
+    pb_free(&pb);
+    return rv;
+}
+
 /**
  * Reads version file and prints
  * kernal version
  */
 void printkernel(){
     char kernel[BUF_SZ];
-    char* smallList[BUF_SZ];
-    int fd2 = open("version", O_RDONLY);
     
-    read_line(kernel, BUF_SZ, fd2);
-    tokenize(smallList, kernel, " ");
+    if (get_kernel(kernel, sizeof(kernel)) == 0) {
+        printf("Kernel Version: %s\n", kernel);
+    }
+}
+
+/**
+ * Reads the hostname from
+ * the hostname file
+ * @param char* buf - destination for the hostname
+ * @param size_t sz - size of buf
+ */
+void get_hostname(char* buf, size_t sz){
+    struct proc_buf pb;
+    char* hostname;
     
-    printf("Kernel Version: %s\n", smallList[2]);
-    close(fd2);
+    pb_init(&pb);
+    pb_load(&pb, "sys/kernel/hostname");
+    hostname = pb_next_line(&pb);
+    snprintf(buf, sz, "%s", hostname != NULL ? hostname : "");
+    pb_free(&pb);
 }
 
 /**
@@ -180,12 +186,9 @@ void printkernel(){
  */
 void hostname(){
     char hostname[BUF_SZ];
-    int fd = open("sys/kernel/hostname", O_RDONLY);
-    
-    read_line(hostname, BUF_SZ, fd);
     
+    get_hostname(hostname, sizeof(hostname));
     printf("Hostname: %s\n", hostname);
-    close(fd);
 }
 
 /**
@@ -216,7 +219,7 @@ void print_uptime(){
     if (years == 0) {
         if (days == 0) {
             if (hours == 0) {
-                printf("Uptime: %d minutes, %d seconds", minutes, seconds);
+                printf("Uptime: %d minutes, %d seconds\n", minutes, seconds);
             } else {
                 printf("Uptime: %d hours, %d minutes, %d seconds\n", hours, minutes, seconds);
             }
@@ -255,59 +258,82 @@ void print_uptime(){
  */
 
 void get_uptime(double uptimeList[2]) {
-    char uptime[BUF_SZ];
-    char * p[BUF_SZ];
-    int fd = open("uptime", O_RDONLY);
-    read_line(uptime, BUF_SZ, fd);
+    struct proc_buf pb;
+    char* uptime;
+    char * p[2];
     
-    tokenize(p, uptime, " ");
+    uptimeList[0] = 0;
+    uptimeList[1] = 0;
     
+    pb_init(&pb);
+    pb_load(&pb, "uptime");
+    uptime = pb_next_line(&pb);
     
-    uptimeList[0] = atof(p[0]);
-    uptimeList[1] = atof(p[1]);
+    if (uptime != NULL && tokenize(p, 2, uptime, " ") == 2) {
+        uptimeList[0] = atof(p[0]);
+        uptimeList[1] = atof(p[1]);
+    }
+    pb_free(&pb);
 }
 
 
 
 /**
- * Calculates the CPU usage
- * by getting the uptime after one second intervals
- * @return the cpu usage time
+ * Samples the CPU counters of /proc/stat twice, window_ms apart
+ * @param struct cpu_sample *before - first sample
+ * @param struct cpu_sample *after - second sample
+ * @param long window_ms - time between the samples, in milliseconds
+ *
+ * @return 0 on success, -1 on error
  */
-double cpu_usage(){
-    double first[2];
-    double second[2];
-    double cpu_time;
-    
-    get_uptime(first);
-    sleep(1);
-    get_uptime(second);
+int cpu_usage(struct cpu_sample *before, struct cpu_sample *after, long window_ms){
+    struct proc_buf pb;
+    int rv = 0;
     
-    if((second[1] - first[1]) == 0){
-        cpu_time = 0;
-    }else{
-        cpu_time = 1 - ((second[0] - first[0]) / (second[1] - first[1]));
+    pb_init(&pb);
+    if (cpu_sample_read(before, &pb) == -1) {
+        rv = -1;
+    } else {
+        usleep(window_ms * 1000);
+        if (cpu_sample_read(after, &pb) == -1) {
+            rv = -1;
+        }
     }
-    
-    return cpu_time;
+    pb_free(&pb);
+    return rv;
 }
 
 /**
- * Calculates the CPU usage
- * by getting the uptime- used for
- * liveview
- * @param double list to update the values
+ * Prints the aggregate CPU usage bar with its breakdown, followed by
+ * one bar per core. Every line ends with a newline.
+ * @param const struct cpu_sample *before - earlier sample
+ * @param const struct cpu_sample *after - later sample
  *
- * @return the cpu usage time
+ * @return the number of lines printed
  */
-double cpu_usage_liveview(double first[2]){
-    double second2[2];
-    double cpu_time;
-    get_uptime(second2);
+int print_cpu_usage(const struct cpu_sample *before, const struct cpu_sample *after){
+    struct cpu_usage usage;
+    int lines = 2;
     
-    cpu_time = 1 - ((second2[0] - first[0]) / (second2[1] - first[1]));
+    cpu_usage_between(&before->total, &after->total, &usage);
+    printf("CPU Usage:\t");
+    percentage_bar(usage.busy);
+    printf("\n  user %.1f%% | system %.1f%% | iowait %.1f%% | irq %.1f%% | steal %.1f%%\n",
+           100 * usage.user, 100 * usage.system, 100 * usage.iowait,
+           100 * usage.irq, 100 * usage.steal);
     
-    return cpu_time;
+    for (int i = 0; i < after->ncores; ++i) {
+        if (i < before->ncores) {
+            cpu_usage_between(&before->cores[i], &after->cores[i], &usage);
+        } else {
+            memset(&usage, 0, sizeof(usage));
+        }
+        printf("  cpu%d:\t\t", after->cores[i].id);
+        percentage_bar(usage.busy);
+        printf("\n");
+        lines++;
+    }
+    return lines;
 }
 
 
@@ -317,6 +343,11 @@ double cpu_usage_liveview(double first[2]){
  * @param number to fill the percentage till
  */
 void percentage_bar(double percentage) {
+    if (percentage < 0) {
+        percentage = 0;
+    } else if (percentage > 1) {
+        percentage = 1;
+    }
     int num_hash = (percentage*100)/5;
     int num_hip = 20 - num_hash;
     int i = 0, j = 0;
@@ -356,71 +387,66 @@ void percentage_bar_mem(double percentage) {
     printf(" %.1f%%", (100*percentage));
 }
 
-/**
- * Trims the whitespace from given string
- * @param any string containing white space
- *
- * @return the string without whitespace
- */
-char *trimwhitespace(char *str)
-{
-    char *end;
-    
-    // Trim leading space
-    while(isspace((unsigned char)*str)) str++;
-    
-    if(*str == 0)  // All spaces?
-        return str;
-    
-    // Trim trailing space
-    end = str + strlen(str) - 1;
-    while(end > str && isspace((unsigned char)*end)) end--;
-    
-    // Write new null terminator character
-    end[1] = '\0';
-    
-    return str;
-}
-
 /**
  * Finds the percentage of memory used
  * by reading the meminfo file from relative
  * proc directory and returns the percentage
  * of memory being used
+ * @param struct mem_info *mem - set to the totals read, if not NULL
  * @return percentage of memory being used
  */
-double mem_usage(){
-    char memTot[BUF_SZ];
-    
-    char* listTotal[BUF_SZ];
-    
-    double totalmem;
-    double freemem;
+double mem_usage(struct mem_info *mem){
+    struct proc_buf pb;
     double used;
     
+    pb_init(&pb);
+    pb_load(&pb, "meminfo");
+    used = parse_meminfo(&pb, mem);
+    pb_free(&pb);
+    return used;
+}
+
+/**
+ * Computes the fraction of memory in use
+ * from loaded meminfo contents
+ * @param struct proc_buf *pb - buffer holding meminfo
+ * @param struct mem_info *mem - set to the totals read, if not NULL
+ * @return percentage of memory being used
+ */
+double parse_meminfo(struct proc_buf *pb, struct mem_info *mem){
+    char* memTot;
     
-    int fd = open("meminfo", O_RDONLY);
+    double totalmem = 0;
+    double freemem = 0;
+    double used;
     
-    while(read_line(memTot, BUF_SZ, fd) != 0){
+    while((memTot = pb_next_line(pb)) != NULL){
         char* temp;
+        char* value;
         
-        tokenize(listTotal, memTot, ":");
-        temp = trimwhitespace(listTotal[0]);
+        temp = split_field(memTot, &value);
+        if(temp == NULL){
+            continue;
+        }
         
         if(strcmp(temp, "MemFree") == 0){
-            freemem = atof(listTotal[1]);
+            freemem = atof(value);
             
         }
         if(strcmp(temp, "MemTotal") == 0){
-            totalmem = atof(listTotal[1]);
+            totalmem = atof(value);
         }
     }
     
     used = totalmem - freemem;
-    if(used < 0){
-        return 0;
+    if(used < 0 || totalmem == 0){
+        used = 0;
     }
-    return used/totalmem;
+    if (mem != NULL) {
+        mem->total_kb = totalmem;
+        mem->used_kb = used;
+    }
+    return totalmem == 0 ? 0 : used/totalmem;
 }
 
 
@@ -431,85 +457,200 @@ double mem_usage(){
  * Units found then calls loadavg function
  */
 void parse_cpuinfo(){
+    char model_name[BUF_SZ];
+    int proc_count = get_cpuinfo(model_name, sizeof(model_name));
+    
+    printf("\nCPU Model: %s\n", model_name);
+    printf("Processing Units: %d\n", proc_count);
+    loadavg();
+}
+
+/**
+ * Reads the CPU model and counts the
+ * processing units in the cpuinfo file
+ * @param char* model_name - destination for the model name
+ * @param size_t sz - size of model_name
+ *
+ * @return the number of processing units
+ */
+int get_cpuinfo(char* model_name, size_t sz){
     int proc_count = 0;
-    char model_name[BUF_SZ] ="";
-    int fd = open("cpuinfo", O_RDONLY);
-    char line[BUF_SZ];
+    struct proc_buf pb;
+    char* line;
     int found = 0;
     
     
-    while(read_line(line, BUF_SZ, fd) != 0){
-        int leng=0;
-        char* tokens[strlen(line) +1];
-        leng = tokenize(tokens, line, " :\t");
-        if(((strcmp(tokens[0],"model") == 0)) && ((strcmp(tokens[1],"name") == 0)) && (found == 0) ){ // Iter through the rest of tokens list and concat the next token
+    model_name[0] = '\0';
+    pb_init(&pb);
+    pb_load(&pb, "cpuinfo");
+    
+    while((line = pb_next_line(&pb)) != NULL){
+        char* key;
+        char* value;
+        
+        key = split_field(line, &value);
+        if(key == NULL){
+            continue;
+        }
+        if((strcmp(key, "model name") == 0) && (found == 0) ){
             found = 1;
-            for(int i = 4; i< leng; i++){
-                strcat(model_name, tokens[i]);
-                strcat(model_name, " ");
-            }
+            snprintf(model_name, sz, "%s", value);
         }
-        if(strcmp(tokens[0], "processor") == 0){
+        if(strcmp(key, "processor") == 0){
             proc_count++;
         }
     }
-    printf("\nCPU Model: %s\n", model_name);
-    printf("Processing Units: %d\n", proc_count);
-    loadavg();
+    pb_free(&pb);
+    return proc_count;
 }
 
 
 
+/**
+ * Returns the number of rows of the terminal, or 24 if it is unknown
+ */
+int terminal_rows(){
+    struct winsize ws;
+    
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1 || ws.ws_row == 0) {
+        return 24;
+    }
+    return ws.ws_row;
+}
+
+/**
+ * Prints the live task table: the top rows of the task map, cut to the
+ * space left on the terminal
+ * @param struct task_map *map - refreshed task map
+ * @param struct task_row ***order - scratch array of row pointers, grown as needed
+ * @param size_t *order_cap - capacity of *order
+ * @param enum task_sort sort_by - order of the rows
+ * @param size_t limit - maximum number of rows to print (0 for all that fit)
+ */
+void print_live_tasks(struct task_map *map, struct task_row ***order, size_t *order_cap,
+                      enum task_sort sort_by, size_t limit){
+    size_t n;
+    size_t max_rows;
+    int free_rows = terminal_rows() - 9;
+    
+    if (*order_cap < map->count) {
+        struct task_row **grown = realloc(*order, map->count * sizeof(struct task_row *));
+        if (grown == NULL) {
+            perror("realloc");
+            return;
+        }
+        *order = grown;
+        *order_cap = map->count;
+    }
+    max_rows = free_rows > 0 ? (size_t) free_rows : 0;
+    if (limit > 0 && limit < max_rows) {
+        max_rows = limit;
+    }
+    n = task_map_rows(map, *order, *order_cap);
+    n = task_top(*order, n, max_rows, sort_by);
+    
+    printf("\n\nTasks: %zu\n", map->count);
+    print_task_header();
+    for (size_t i = 0; i < n; ++i) {
+        print_task_row((*order)[i]);
+    }
+}
+
+/**
+ * Procfs files sampled on every live view tick. Each one is opened
+ * once and re-read in place, so the view uses a fixed number of
+ * descriptors however long it runs.
+ */
+struct live_files {
+    struct proc_file meminfo;
+    struct proc_file loadavg;
+    struct proc_file stat;
+};
+
 /**
  * This is the live view function, repeatedly
  * calls percentage bars to be printed
+ * @param bool tasks - also show the task table, refreshed incrementally
+ * @param enum task_sort sort_by - order of the task table
+ * @param size_t limit - maximum number of task rows (0 for all that fit)
+ * @param long interval_ms - time between refreshes, in milliseconds
  */
-void live_view(){
+void live_view(bool tasks, enum task_sort sort_by, size_t limit, long interval_ms){
+    struct live_files files;
+    struct task_map map;
+    struct proc_buf pb;
+    struct task_row **order = NULL;
+    size_t order_cap = 0;
+    
     printf("\e[?25l");
     printf("Live View/Memory View\n");
     printf("--------------------\n");
     
-    double cpu_sample;
-    double cpu_1[2];
+    struct cpu_sample cpu_prev;
+    struct cpu_sample cpu_cur;
+    struct cpu_sample cpu_swap;
     double mem2;
     
     
     
-    mem2 = mem_usage();
+    pf_open(&files.meminfo, "meminfo");
+    pf_open(&files.loadavg, "loadavg");
+    pf_open(&files.stat, "stat");
     
-    get_uptime(cpu_1);
-    cpu_sample = cpu_1[0];
+    mem2 = pf_read(&files.meminfo) ? parse_meminfo(&files.meminfo.pb, NULL) : 0;
+    
+    pb_init(&pb);
+    cpu_sample_init(&cpu_prev);
+    cpu_sample_init(&cpu_cur);
+    if (pf_read(&files.stat) != NULL) {
+        cpu_sample_parse(&cpu_prev, &files.stat.pb);
+    }
+    if (tasks && task_map_init(&map) == -1) {
+        tasks = false;
+    }
     
     while(true) {
         double mem3;
-        sleep(1);
-        loadavg();
-        cpu_sample = cpu_usage_liveview(cpu_1);
-        mem3 = mem_usage();
-        printf("CPU Usage:\t");
-        percentage_bar(cpu_sample);
-        printf("\nMemory Usage:\t");
+        int lines;
+        usleep(interval_ms * 1000);
+        if (tasks) {
+            /* The table changes length between ticks: redraw everything */
+            task_map_refresh(&map, &pb);
+            printf("\033[H\033[J");
+            printf("Live View/Memory View\n");
+            printf("--------------------\n");
+        }
+        if (pf_read(&files.loadavg) != NULL) {
+            print_loadavg(&files.loadavg.pb);
+        }
+        if (pf_read(&files.stat) != NULL) {
+            cpu_sample_parse(&cpu_cur, &files.stat.pb);
+        }
+        lines = print_cpu_usage(&cpu_prev, &cpu_cur);
+        cpu_swap = cpu_prev;
+        cpu_prev = cpu_cur;
+        cpu_cur = cpu_swap;
+        mem3 = pf_read(&files.meminfo) ? parse_meminfo(&files.meminfo.pb, NULL) : 0;
+        printf("Memory Usage:\t");
         percentage_bar_mem(((mem3+mem2)/2));
         mem2 = mem3;
-        printf("\r\033[A\033[A");
-    }
-    printf("\e[?25h");
-}
-
-
-/**
- * This checks if given number
- * is a digit
- * @param const char *s - any character
- * @return
- */
-int digits_only(const char *s) {
-    while (*s) {
-        if (isdigit(*s++) == 0) {
-            return 0;
+        if (tasks) {
+            print_live_tasks(&map, &order, &order_cap, sort_by, limit);
+        } else {
+            /* Back to the load average line, above the CPU lines */
+            printf("\r\033[%dA", lines + 1);
         }
+        fflush(stdout);
     }
-    return 1;
+    cpu_sample_free(&cpu_prev);
+    cpu_sample_free(&cpu_cur);
+    pf_close(&files.meminfo);
+    pf_close(&files.loadavg);
+    pf_close(&files.stat);
+    free(order);
+    task_map_free(&map);
+    pb_free(&pb);
+    printf("\e[?25h");
 }
 
 
@@ -534,11 +675,30 @@ void taskcount() {
             }
             
         }
+        closedir(d);
     }
-    printf("\nTasks Running: %d\n", taskcount-3);
+    printf("\nTasks Running: %d\n", taskcount);
 }
 
 
+/**
+ * Prints the header of the task table
+ */
+void print_task_header(){
+    printf("%5s | %12s | %25s | %15s | %5s | %6s | %s \n", "PID", "State", "Task Name", "User", "Tasks", "CPU%", "RSS (kB)");
+    printf("------+--------------+---------------------------+-----------------+-------+--------+----------");
+}
+
+/**
+ * Prints one row of the task table
+ * @param const struct task_row *row - the row to print
+ */
+void print_task_row(const struct task_row *row){
+    printf("\n%5d | %12s | %25s | %15s | %5d | %6.1f | %llu ",
+           (int) row->pid, row->state, row->name, row->user, row->threads,
+           row->cpu, row->rss);
+}
+
 /**
  * This functions prints all the
  * process found in the relative
@@ -546,106 +706,39 @@ void taskcount() {
  * information Including PID, Task
  * name, Tasks and state then prints
  * in a specified format
+ * @param int jobs - number of threads used to scan the task list
+ * @param enum task_sort sort_by - order of the rows
+ * @param size_t limit - maximum number of rows to print (0 for all)
+ * @param long window_ms - CPU sampling window, in milliseconds
  */
-void num_process() {
-    DIR *d;
+void num_process(int jobs, enum task_sort sort_by, size_t limit, long window_ms) {
+    struct task_table table;
+    struct task_row **order;
+    size_t n;
     
-    d = opendir("./");
+    if (task_scan(&table, jobs) == -1) {
+        return;
+    }
+    task_sample_cpu(&table, jobs, window_ms);
     
-    if (d) {
-        int fd;
-        char line[BUF_SZ];
-        struct dirent *dir;
-        char taskname[26];
-        char* words[BUF_SZ];
-        char user[16];
-        char task[10];
-        
-        char state[13] = " ";
-        char PID[6];
-        int leng;
-        
-        printf("%5s | %12s | %25s | %15s | %s \n", "PID", "State", "Task Name", "User", "Tasks");
-        printf("------+--------------+---------------------------+-----------------+-------");
-        
-        while ((dir = readdir(d)) != NULL){
-            
-            if (digits_only(dir->d_name)){
-                strcat(dir->d_name,"/status");
-                fd = open(dir->d_name, O_RDONLY);
-                
-                while(read_line(line, BUF_SZ, fd) != 0){
-                    
-                    leng = tokenize(words, line, ":");
-                    
-                    if(strcmp(words[0], "Name") == 0){
-                        strncpy(taskname, trimwhitespace(words[leng - 1]),25);
-                        strcat(taskname,"\0");
-                    }
-                    
-                    if(strcmp(words[0], "State") == 0) {
-                        char temp[13];
-                        char *t2;
-                        strcpy(temp, words[leng-1]);
-                        t2 = trimwhitespace(temp);
-                        
-                        if(strcmp(t2, "S (sleeping)") == 0){
-                            strncpy(state,"sleeping", 12);
-                            strcat(state,"\0");
-                        }else if(strcmp(t2, "I (idle)") == 0){
-                            strncpy(state,"idle",12);
-                            strcat(state,"\0");
-                        }
-                        else if(strcmp(t2, "A (active)") == 0){
-                            strncpy(state,"active",12);
-                            strcat(state,"\0");
-                        }
-                        else if(strcmp(t2, "Z (zombie)") == 0){
-                            strncpy(state,"zombie",12);
-                            strcat(state,"\0");
-                        }
-                        else if(strcmp(t2, "X (dead)") == 0){
-                            strncpy(state,"dead",12);
-                            strcat(state,"\0");
-                        }
-                        else if(strcmp(t2, "D (disk sleep)") == 0){
-                            strncpy(state,"disk sleep",12);
-                            strcat(state,"\0");
-                        }
-                        
-                    }
-                    
-                    if(strcmp(words[0], "Pid") == 0){
-                        strncpy(PID, trimwhitespace(words[leng -1]), 6);
-                        strcat(PID,"\0");
-                    }
-                    
-                    if(strcmp(words[0], "Uid") == 0){
-                        if(getpwuid(atoi(words[leng -1])) == NULL){
-                            itoa(atoi(words[leng -1]), user);
-                            
-                        }else{
-                            strncpy(user, trimwhitespace(getpwuid(atoi(words[leng -1]))->pw_name), 15);
-                            strcat(user,"\0");
-                            
-                        }
-                    }
-                    if(strcmp(words[0], "Threads") == 0) {
-                        strncpy(task, trimwhitespace(words[leng -1]),9);
-                        strcat(task,"\0");
-                    }
-                    
-                }
-            }
-            if(strcmp(PID, "") !=0) {
-                printf("\n%5s | %12s | %25s | %15s | %s ",
-                       PID, state, taskname, user, task);
-            }
-        }
-        
-        //        closedir(d);
+    order = malloc((table.count > 0 ? table.count : 1) * sizeof(struct task_row *));
+    if (order == NULL) {
+        perror("malloc");
+        task_table_free(&table);
+        return;
+    }
+    for (size_t i = 0; i < table.count; ++i) {
+        order[i] = &table.rows[i];
+    }
+    n = task_top(order, table.count, limit > 0 ? limit : table.count, sort_by);
+    
+    print_task_header();
+    for (size_t i = 0; i < n; ++i) {
+        print_task_row(order[i]);
     }
     
+    free(order);
+    task_table_free(&table);
 }
 
 
@@ -684,21 +777,671 @@ char* itoa(int i, char b[]){
  * load times by reading loadavg
  */
 void loadavg() {
-    int fd = open("loadavg", O_RDONLY);
-    char line[BUF_SZ];
+    struct proc_buf pb;
+    
+    pb_init(&pb);
+    pb_load(&pb, "loadavg");
+    print_loadavg(&pb);
+    pb_free(&pb);
+}
+
+/**
+ * Parses the load averages
+ * from loaded loadavg contents
+ * @param struct proc_buf *pb - buffer holding loadavg
+ * @param double load[3] - set to the 1, 5 and 15 minute averages
+ */
+void parse_loadavg(struct proc_buf *pb, double load[3]) {
+    char* line = pb_next_line(pb);
+    char* tokens[3];
+    int leng = line != NULL ? tokenize(tokens, 3, line, " ") : 0;
+    
+    for(int s = 0; s < 3; s++) {
+        load[s] = s < leng ? atof(tokens[s]) : 0;
+    }
+}
+
+/**
+ * Prints the load averages
+ * from loaded loadavg contents
+ * @param struct proc_buf *pb - buffer holding loadavg
+ */
+void print_loadavg(struct proc_buf *pb) {
+    char* line;
     
     printf("Load Average (1/5/15 min): ");
-    while(read_line(line, BUF_SZ, fd) != 0){
-        char* tokens[strlen(line) +1];
-        tokenize(tokens, line, " ");
-        for(int s = 0; s < 3; s++) {
-            printf("%s", tokens[s]);
+    while((line = pb_next_line(pb)) != NULL){
+        char* tokens[3];
+        int leng = tokenize(tokens, 3, line, " ");
+        for(int s = 0; s < leng; s++) {
+            printf(s == 0 ? "%s" : " %s", tokens[s]);
         }
         printf("\n");
     }
 }
 
 
+/**
+ * Everything the machine-readable output modes report. Sections
+ * that were not requested are left empty.
+ */
+struct report {
+    struct view_opts options;
+    char hostname[BUF_SZ];
+    char kernel[BUF_SZ];
+    double uptime;
+    char model[BUF_SZ];
+    int units;
+    double load[3];
+    struct cpu_sample cpu_before;
+    struct cpu_sample cpu_after;
+    struct mem_info mem;
+    struct task_table table;
+    struct task_row **order;
+    size_t nrows;
+};
+
+/**
+ * Gathers the requested sections into a report. When both the
+ * hardware and the task sections are requested, the CPU samples
+ * of the two share one sampling window.
+ * @param struct report *r - report to fill; free with free_report
+ * @param struct view_opts options - sections to gather
+ * @param int jobs - number of threads used to scan the task list
+ * @param enum task_sort sort_by - order of the task rows
+ * @param size_t limit - maximum number of task rows (0 for all)
+ * @param long window_ms - CPU sampling window, in milliseconds
+ */
+void collect_report(struct report *r, struct view_opts options, int jobs,
+                    enum task_sort sort_by, size_t limit, long window_ms){
+    struct proc_buf pb;
+    
+    memset(r, 0, sizeof(*r));
+    r->options = options;
+    cpu_sample_init(&r->cpu_before);
+    cpu_sample_init(&r->cpu_after);
+    pb_init(&pb);
+    
+    if (options.system) {
+        double d[2];
+        
+        get_hostname(r->hostname, sizeof(r->hostname));
+        get_kernel(r->kernel, sizeof(r->kernel));
+        get_uptime(d);
+        r->uptime = d[0];
+    }
+    if (options.hardware) {
+        r->units = get_cpuinfo(r->model, sizeof(r->model));
+        pb_load(&pb, "loadavg");
+        parse_loadavg(&pb, r->load);
+        mem_usage(&r->mem);
+        cpu_sample_read(&r->cpu_before, &pb);
+    }
+    if (options.task_list) {
+        task_scan(&r->table, jobs);
+        task_sample_cpu(&r->table, jobs, window_ms);
+        
+        r->order = malloc((r->table.count > 0 ? r->table.count : 1) * sizeof(struct task_row *));
+        if (r->order == NULL) {
+            perror("malloc");
+        } else {
+            for (size_t i = 0; i < r->table.count; ++i) {
+                r->order[i] = &r->table.rows[i];
+            }
+            r->nrows = task_top(r->order, r->table.count,
+                                limit > 0 ? limit : r->table.count, sort_by);
+        }
+    } else if (options.hardware) {
+        usleep(window_ms * 1000);
+    }
+    if (options.hardware) {
+        cpu_sample_read(&r->cpu_after, &pb);
+    }
+    pb_free(&pb);
+}
+
+/**
+ * Releases the memory held by a report
+ * @param struct report *r - report to free
+ */
+void free_report(struct report *r){
+    cpu_sample_free(&r->cpu_before);
+    cpu_sample_free(&r->cpu_after);
+    task_table_free(&r->table);
+    free(r->order);
+    r->order = NULL;
+}
+
+/**
+ * Appends the fields of a CPU utilization breakdown to a JSON object
+ * @param struct outbuf *ob - output buffer
+ * @param const struct cpu_usage *u - utilization to append
+ */
+void json_cpu_fields(struct outbuf *ob, const struct cpu_usage *u){
+    ob_printf(ob, "\"usage\":%.4f,\"user\":%.4f,\"system\":%.4f,"
+              "\"iowait\":%.4f,\"irq\":%.4f,\"steal\":%.4f",
+              u->busy, u->user, u->system, u->iowait, u->irq, u->steal);
+}
+
+/**
+ * Appends the aggregate and per-core CPU utilization as a JSON object
+ * @param struct outbuf *ob - output buffer
+ * @param const struct cpu_sample *before - earlier sample
+ * @param const struct cpu_sample *after - later sample
+ */
+void json_cpu(struct outbuf *ob, const struct cpu_sample *before,
+              const struct cpu_sample *after){
+    struct cpu_usage usage;
+    
+    cpu_usage_between(&before->total, &after->total, &usage);
+    ob_printf(ob, "{");
+    json_cpu_fields(ob, &usage);
+    ob_printf(ob, ",\"cores\":[");
+    for (int i = 0; i < after->ncores; ++i) {
+        if (i < before->ncores) {
+            cpu_usage_between(&before->cores[i], &after->cores[i], &usage);
+        } else {
+            memset(&usage, 0, sizeof(usage));
+        }
+        ob_printf(ob, "%s{\"id\":%d,", i == 0 ? "" : ",", after->cores[i].id);
+        json_cpu_fields(ob, &usage);
+        ob_printf(ob, "}");
+    }
+    ob_printf(ob, "]}");
+}
+
+/**
+ * Appends memory totals as a JSON object
+ * @param struct outbuf *ob - output buffer
+ * @param const struct mem_info *mem - totals to append
+ */
+void json_memory(struct outbuf *ob, const struct mem_info *mem){
+    ob_printf(ob, "{\"usage\":%.4f,\"used_kb\":%.0f,\"total_kb\":%.0f}",
+              mem->total_kb > 0 ? mem->used_kb / mem->total_kb : 0,
+              mem->used_kb, mem->total_kb);
+}
+
+/**
+ * Appends task rows as a JSON array
+ * @param struct outbuf *ob - output buffer
+ * @param struct task_row **rows - rows to append
+ * @param size_t n - number of rows
+ */
+void json_tasks(struct outbuf *ob, struct task_row **rows, size_t n){
+    ob_printf(ob, "[");
+    for (size_t i = 0; i < n; ++i) {
+        const struct task_row *row = rows[i];
+        
+        ob_printf(ob, "%s{\"pid\":%d,\"state\":", i == 0 ? "" : ",", (int) row->pid);
+        ob_json_str(ob, row->state);
+        ob_printf(ob, ",\"name\":");
+        ob_json_str(ob, row->name);
+        ob_printf(ob, ",\"user\":");
+        ob_json_str(ob, row->user);
+        ob_printf(ob, ",\"threads\":%d,\"cpu\":%.2f,\"rss_kb\":%llu}",
+                  row->threads, row->cpu, row->rss);
+    }
+    ob_printf(ob, "]");
+}
+
+/**
+ * Appends a report as one JSON object
+ * @param struct outbuf *ob - output buffer
+ * @param const struct report *r - report to append
+ */
+void report_json(struct outbuf *ob, const struct report *r){
+    const char *sep = "";
+    
+    ob_printf(ob, "{");
+    if (r->options.system) {
+        ob_printf(ob, "\"system\":{\"hostname\":");
+        ob_json_str(ob, r->hostname);
+        ob_printf(ob, ",\"kernel\":");
+        ob_json_str(ob, r->kernel);
+        ob_printf(ob, ",\"uptime\":%.2f}", r->uptime);
+        sep = ",";
+    }
+    if (r->options.hardware) {
+        ob_printf(ob, "%s\"hardware\":{\"cpu_model\":", sep);
+        ob_json_str(ob, r->model);
+        ob_printf(ob, ",\"processing_units\":%d,\"load_average\":[%.2f,%.2f,%.2f],\"cpu\":",
+                  r->units, r->load[0], r->load[1], r->load[2]);
+        json_cpu(ob, &r->cpu_before, &r->cpu_after);
+        ob_printf(ob, ",\"memory\":");
+        json_memory(ob, &r->mem);
+        ob_printf(ob, "}");
+        sep = ",";
+    }
+    if (r->options.task_list) {
+        ob_printf(ob, "%s\"tasks\":{\"count\":%zu,\"rows\":", sep, r->table.count);
+        json_tasks(ob, r->order, r->nrows);
+        ob_printf(ob, "}");
+    }
+    ob_printf(ob, "}\n");
+}
+
+/**
+ * Appends one section,field,value line with a string value
+ */
+void csv_field(struct outbuf *ob, const char *section, const char *field, const char *value){
+    ob_printf(ob, "%s,%s,", section, field);
+    ob_csv_str(ob, value);
+    ob_printf(ob, "\n");
+}
+
+/**
+ * Appends one section,field,value line with a numeric value
+ */
+void csv_number(struct outbuf *ob, const char *section, const char *field, double value){
+    ob_printf(ob, "%s,%s,%.4f\n", section, field, value);
+}
+
+/**
+ * Appends one section,field,value line with a count
+ */
+void csv_count(struct outbuf *ob, const char *section, const char *field, unsigned long long value){
+    ob_printf(ob, "%s,%s,%llu\n", section, field, value);
+}
+
+/**
+ * Appends a report as CSV: section,field,value lines for the system
+ * and hardware sections, then the task table after a blank line
+ * @param struct outbuf *ob - output buffer
+ * @param const struct report *r - report to append
+ */
+void report_csv(struct outbuf *ob, const struct report *r){
+    struct cpu_usage usage;
+    char field[64];
+    
+    ob_printf(ob, "section,field,value\n");
+    if (r->options.system) {
+        csv_field(ob, "system", "hostname", r->hostname);
+        csv_field(ob, "system", "kernel", r->kernel);
+        csv_number(ob, "system", "uptime", r->uptime);
+    }
+    if (r->options.hardware) {
+        csv_field(ob, "hardware", "cpu_model", r->model);
+        csv_count(ob, "hardware", "processing_units", r->units);
+        csv_number(ob, "hardware", "load_1", r->load[0]);
+        csv_number(ob, "hardware", "load_5", r->load[1]);
+        csv_number(ob, "hardware", "load_15", r->load[2]);
+        
+        cpu_usage_between(&r->cpu_before.total, &r->cpu_after.total, &usage);
+        csv_number(ob, "hardware", "cpu_usage", usage.busy);
+        csv_number(ob, "hardware", "cpu_user", usage.user);
+        csv_number(ob, "hardware", "cpu_system", usage.system);
+        csv_number(ob, "hardware", "cpu_iowait", usage.iowait);
+        csv_number(ob, "hardware", "cpu_irq", usage.irq);
+        csv_number(ob, "hardware", "cpu_steal", usage.steal);
+        for (int i = 0; i < r->cpu_after.ncores && i < r->cpu_before.ncores; ++i) {
+            cpu_usage_between(&r->cpu_before.cores[i], &r->cpu_after.cores[i], &usage);
+            snprintf(field, sizeof(field), "cpu%d_usage", r->cpu_after.cores[i].id);
+            csv_number(ob, "hardware", field, usage.busy);
+        }
+        
+        csv_count(ob, "hardware", "mem_used_kb", r->mem.used_kb);
+        csv_count(ob, "hardware", "mem_total_kb", r->mem.total_kb);
+    }
+    if (r->options.task_list) {
+        csv_count(ob, "tasks", "count", r->table.count);
+        ob_printf(ob, "\npid,state,name,user,threads,cpu,rss_kb\n");
+        for (size_t i = 0; i < r->nrows; ++i) {
+            const struct task_row *row = r->order[i];
+            
+            ob_printf(ob, "%d,", (int) row->pid);
+            ob_csv_str(ob, row->state);
+            ob_printf(ob, ",");
+            ob_csv_str(ob, row->name);
+            ob_printf(ob, ",");
+            ob_csv_str(ob, row->user);
+            ob_printf(ob, ",%d,%.2f,%llu\n", row->threads, row->cpu, row->rss);
+        }
+    }
+}
+
+/**
+ * Prints the requested sections in a machine-readable format. The
+ * whole report is built in one buffer and written with a single write.
+ * @param enum output_format format - OUTPUT_JSON or OUTPUT_CSV
+ * @param struct view_opts options - sections to print
+ * @param int jobs - number of threads used to scan the task list
+ * @param enum task_sort sort_by - order of the task rows
+ * @param size_t limit - maximum number of task rows (0 for all)
+ * @param long window_ms - CPU sampling window, in milliseconds
+ */
+void print_report(enum output_format format, struct view_opts options, int jobs,
+                  enum task_sort sort_by, size_t limit, long window_ms){
+    struct report r;
+    struct outbuf ob;
+    
+    collect_report(&r, options, jobs, sort_by, limit, window_ms);
+    ob_init(&ob);
+    if (format == OUTPUT_JSON) {
+        report_json(&ob, &r);
+    } else {
+        report_csv(&ob, &r);
+    }
+    ob_flush(&ob, STDOUT_FILENO);
+    ob_free(&ob);
+    free_report(&r);
+}
+
+/**
+ * Machine-readable live view: one NDJSON object (or one CSV row)
+ * per tick, each written with a single write
+ * @param enum output_format format - OUTPUT_JSON or OUTPUT_CSV
+ * @param bool tasks - include the task rows (JSON only)
+ * @param enum task_sort sort_by - order of the task rows
+ * @param size_t limit - maximum number of task rows (0 for all)
+ * @param long interval_ms - time between ticks, in milliseconds
+ */
+void live_stream(enum output_format format, bool tasks, enum task_sort sort_by,
+                 size_t limit, long interval_ms){
+    struct live_files files;
+    struct task_map map;
+    struct proc_buf pb;
+    struct task_row **order = NULL;
+    size_t order_cap = 0;
+    struct cpu_sample cpu_prev;
+    struct cpu_sample cpu_cur;
+    struct cpu_sample cpu_swap;
+    struct outbuf ob;
+    
+    pf_open(&files.meminfo, "meminfo");
+    pf_open(&files.loadavg, "loadavg");
+    pf_open(&files.stat, "stat");
+    pb_init(&pb);
+    ob_init(&ob);
+    cpu_sample_init(&cpu_prev);
+    cpu_sample_init(&cpu_cur);
+    if (pf_read(&files.stat) != NULL) {
+        cpu_sample_parse(&cpu_prev, &files.stat.pb);
+    }
+    if (format != OUTPUT_JSON || (tasks && task_map_init(&map) == -1)) {
+        tasks = false;
+    }
+    if (format == OUTPUT_CSV) {
+        ob_printf(&ob, "time,load_1,load_5,load_15,cpu_usage,cpu_user,cpu_system,"
+                  "cpu_iowait,cpu_irq,cpu_steal,mem_used_kb,mem_total_kb\n");
+    }
+    
+    while(true) {
+        struct timespec now;
+        struct mem_info mem = { 0, 0 };
+        struct cpu_usage usage;
+        double load[3] = { 0, 0, 0 };
+        size_t n = 0;
+        
+        usleep(interval_ms * 1000);
+        clock_gettime(CLOCK_REALTIME, &now);
+        if (pf_read(&files.loadavg) != NULL) {
+            parse_loadavg(&files.loadavg.pb, load);
+        }
+        if (pf_read(&files.meminfo) != NULL) {
+            parse_meminfo(&files.meminfo.pb, &mem);
+        }
+        if (pf_read(&files.stat) != NULL) {
+            cpu_sample_parse(&cpu_cur, &files.stat.pb);
+        }
+        if (tasks && task_map_refresh(&map, &pb) == 0) {
+            if (order_cap < map.count) {
+                struct task_row **grown = realloc(order, map.count * sizeof(struct task_row *));
+                if (grown != NULL) {
+                    order = grown;
+                    order_cap = map.count;
+                }
+            }
+            n = task_map_rows(&map, order, order_cap);
+            n = task_top(order, n, limit > 0 ? limit : n, sort_by);
+        }
+        
+        if (format == OUTPUT_JSON) {
+            ob_printf(&ob, "{\"time\":%lld.%03ld,\"load_average\":[%.2f,%.2f,%.2f],\"cpu\":",
+                      (long long) now.tv_sec, now.tv_nsec / 1000000,
+                      load[0], load[1], load[2]);
+            json_cpu(&ob, &cpu_prev, &cpu_cur);
+            ob_printf(&ob, ",\"memory\":");
+            json_memory(&ob, &mem);
+            if (tasks) {
+                ob_printf(&ob, ",\"task_count\":%zu,\"tasks\":", map.count);
+                json_tasks(&ob, order, n);
+            }
+            ob_printf(&ob, "}\n");
+        } else {
+            cpu_usage_between(&cpu_prev.total, &cpu_cur.total, &usage);
+            ob_printf(&ob, "%lld.%03ld,%.2f,%.2f,%.2f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.0f,%.0f\n",
+                      (long long) now.tv_sec, now.tv_nsec / 1000000,
+                      load[0], load[1], load[2], usage.busy, usage.user,
+                      usage.system, usage.iowait, usage.irq, usage.steal,
+                      mem.used_kb, mem.total_kb);
+        }
+        if (ob_flush(&ob, STDOUT_FILENO) == -1) {
+            /* The reader went away */
+            break;
+        }
+        
+        cpu_swap = cpu_prev;
+        cpu_prev = cpu_cur;
+        cpu_cur = cpu_swap;
+    }
+    
+    if (tasks) {
+        task_map_free(&map);
+    }
+    free(order);
+    ob_free(&ob);
+    cpu_sample_free(&cpu_prev);
+    cpu_sample_free(&cpu_cur);
+    pf_close(&files.meminfo);
+    pf_close(&files.loadavg);
+    pf_close(&files.stat);
+    pb_free(&pb);
+}
+
+
+/* Set from signal handlers; checked by the daemon loop */
+static volatile sig_atomic_t dump_requested = 0;
+static volatile sig_atomic_t stop_requested = 0;
+
+/**
+ * Signal handler of the daemon mode. SIGUSR1 asks for a dump, anything
+ * else for a final dump and exit.
+ * @param int signo - signal number
+ */
+void daemon_signal(int signo){
+    if (signo == SIGUSR1) {
+        dump_requested = 1;
+    } else {
+        stop_requested = 1;
+    }
+}
+
+/**
+ * Counts the processes in an open procfs directory
+ * @param DIR *d - procfs directory, rewound before counting
+ *
+ * @return the number of process directories
+ */
+unsigned int count_tasks(DIR *d){
+    struct dirent *dir;
+    unsigned int count = 0;
+    
+    rewinddir(d);
+    while ((dir = readdir(d)) != NULL) {
+        if (isdigit((unsigned char) dir->d_name[0])) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * Dumps the time series to a file or to stdout. A file is written under
+ * a temporary name and renamed over the old dump, so readers never see a
+ * partial one.
+ * @param const struct series *ring - time series to dump
+ * @param enum output_format format - OUTPUT_BINARY or OUTPUT_CSV
+ * @param long interval_ms - sampling interval
+ * @param const char *path - destination file, or NULL for stdout
+ */
+void dump_series(const struct series *ring, enum output_format format,
+                 long interval_ms, const char *path){
+    char tmp[PATH_MAX];
+    int fd;
+    
+    if (path == NULL) {
+        series_dump(ring, format, interval_ms, STDOUT_FILENO);
+        return;
+    }
+    
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        perror("open");
+        return;
+    }
+    if (series_dump(ring, format, interval_ms, fd) == -1) {
+        close(fd);
+        unlink(tmp);
+        return;
+    }
+    close(fd);
+    if (rename(tmp, path) == -1) {
+        perror("rename");
+        unlink(tmp);
+    }
+}
+
+/**
+ * Headless sampling daemon. Every interval, CPU, memory, load and the
+ * task count are recorded into a preallocated ring of samples. The ring
+ * is dumped on SIGUSR1, and once more on SIGINT or SIGTERM before exiting.
+ * Everything the loop needs is allocated before the first tick.
+ * @param long interval_ms - time between samples, in milliseconds
+ * @param size_t length - number of samples kept
+ * @param enum output_format format - OUTPUT_BINARY or OUTPUT_CSV dumps
+ * @param const char *path - dump file, or NULL for stdout
+ *
+ * @return 0 on success, -1 on error
+ */
+int daemon_mode(long interval_ms, size_t length, enum output_format format,
+                const char *path){
+    struct live_files files;
+    struct series ring;
+    struct cpu_sample cpu_prev;
+    struct cpu_sample cpu_cur;
+    struct cpu_sample cpu_swap;
+    struct sigaction sa;
+    struct timespec next;
+    DIR *procdir;
+    
+    if (series_init(&ring, length) == -1) {
+        return -1;
+    }
+    procdir = opendir(".");
+    if (procdir == NULL) {
+        perror("opendir");
+        series_free(&ring);
+        return -1;
+    }
+    pf_open(&files.meminfo, "meminfo");
+    pf_open(&files.loadavg, "loadavg");
+    pf_open(&files.stat, "stat");
+    cpu_sample_init(&cpu_prev);
+    cpu_sample_init(&cpu_cur);
+    /* Sizes the buffers of both samples, so the loop does not allocate */
+    if (pf_read(&files.stat) != NULL) {
+        cpu_sample_parse(&cpu_cur, &files.stat.pb);
+        pf_read(&files.stat);
+        cpu_sample_parse(&cpu_prev, &files.stat.pb);
+    }
+    
+    /* No SA_RESTART: a signal cuts the sleep short */
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = daemon_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR1, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    
+    LOG("Sampling every %ld ms into %zu slots\n", interval_ms, length);
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!stop_requested) {
+        struct series_sample sample;
+        struct timespec now;
+        struct mem_info mem = { 0, 0 };
+        struct cpu_usage usage;
+        double load[3] = { 0, 0, 0 };
+        
+        /* Absolute deadlines keep the sampling period from drifting */
+        next.tv_sec += interval_ms / 1000;
+        next.tv_nsec += (interval_ms % 1000) * 1000000;
+        if (next.tv_nsec >= 1000000000) {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000;
+        }
+        /* A SIGUSR1 that came while sampling is answered before sleeping,
+         * one that cuts the sleep short right away */
+        while (!stop_requested) {
+            int rc;
+            
+            if (dump_requested) {
+                dump_requested = 0;
+                dump_series(&ring, format, interval_ms, path);
+            }
+            rc = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+            if (rc != EINTR) {
+                break;
+            }
+        }
+        if (stop_requested) {
+            break;
+        }
+        
+        if (pf_read(&files.loadavg) != NULL) {
+            parse_loadavg(&files.loadavg.pb, load);
+        }
+        if (pf_read(&files.meminfo) != NULL) {
+            parse_meminfo(&files.meminfo.pb, &mem);
+        }
+        if (pf_read(&files.stat) != NULL) {
+            cpu_sample_parse(&cpu_cur, &files.stat.pb);
+        }
+        cpu_usage_between(&cpu_prev.total, &cpu_cur.total, &usage);
+        cpu_swap = cpu_prev;
+        cpu_prev = cpu_cur;
+        cpu_cur = cpu_swap;
+        
+        clock_gettime(CLOCK_REALTIME, &now);
+        sample.time_ms = (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+        sample.mem_used_kb = mem.used_kb;
+        sample.mem_total_kb = mem.total_kb;
+        sample.load[0] = load[0];
+        sample.load[1] = load[1];
+        sample.load[2] = load[2];
+        sample.cpu_busy = usage.busy;
+        sample.cpu_user = usage.user;
+        sample.cpu_system = usage.system;
+        sample.cpu_iowait = usage.iowait;
+        sample.tasks = count_tasks(procdir);
+        series_push(&ring, &sample);
+    }
+    
+    /* The final dump also answers a pending SIGUSR1 */
+    dump_requested = 0;
+    dump_series(&ring, format, interval_ms, path);
+    
+    closedir(procdir);
+    cpu_sample_free(&cpu_prev);
+    cpu_sample_free(&cpu_cur);
+    pf_close(&files.meminfo);
+    pf_close(&files.loadavg);
+    pf_close(&files.stat);
+    series_free(&ring);
+    return 0;
+}
+
+
 /**
  * Main program entrypoint. Reads command line options and runs the appropriate
  * subroutines to display system information.
@@ -709,25 +1452,90 @@ int main(int argc, char *argv[])
     char *procfs_loc = "/proc";
     /* Set to true if we are using a non-default proc location */
     bool alt_proc = false;
+    /* Number of threads used to scan the task list */
+    int jobs = default_jobs();
+    /* Order and length of the task list */
+    enum task_sort sort_by = SORT_PID;
+    size_t limit = 0;
+    /* Window between the two samples of CPU usage, in ms */
+    long window_ms = DEFAULT_SAMPLE_MS;
+    bool window_set = false;
+    /* Format of the report */
+    enum output_format format = OUTPUT_TEXT;
+    /* Daemon mode: sampling interval (0 when disabled), ring length, dump file */
+    long daemon_ms = 0;
+    size_t daemon_samples = DAEMON_SAMPLES;
+    char *dump_path = NULL;
+    char dump_abs[PATH_MAX];
     
     struct view_opts defaults = { true, false, true, true };
     struct view_opts options = { false, false, false, false };
     
     int c;
     opterr = 0;
-    while ((c = getopt(argc, argv, "ahlp:rst")) != -1) {
+    while ((c = getopt(argc, argv, "ad:f:hj:ln:N:o:p:rsS:tw:")) != -1) {
         opterr++;
         
         switch (c) {
             case 'a':
                 options = defaults;
                 break;
+            case 'd':
+                daemon_ms = atol(optarg);
+                if (daemon_ms < 1) {
+                    fprintf(stderr, "Invalid sampling interval: %s\n", optarg);
+                    print_usage(argv);
+                    return 1;
+                }
+                break;
+            case 'f':
+                dump_path = optarg;
+                break;
             case 'h':
                 print_usage(argv);
                 return 0;
+            case 'j':
+                jobs = atoi(optarg);
+                if (jobs < 1) {
+                    fprintf(stderr, "Invalid job count: %s\n", optarg);
+                    print_usage(argv);
+                    return 1;
+                }
+                break;
             case 'l':
                 options.live_view = true;
                 break;
+            case 'n':
+                if (atoi(optarg) < 1) {
+                    fprintf(stderr, "Invalid task count: %s\n", optarg);
+                    print_usage(argv);
+                    return 1;
+                }
+                limit = atoi(optarg);
+                break;
+            case 'N':
+                if (atol(optarg) < 1) {
+                    fprintf(stderr, "Invalid sample count: %s\n", optarg);
+                    print_usage(argv);
+                    return 1;
+                }
+                daemon_samples = atol(optarg);
+                break;
+            case 'o':
+                if (strcmp(optarg, "text") == 0) {
+                    format = OUTPUT_TEXT;
+                } else if (strcmp(optarg, "json") == 0) {
+                    format = OUTPUT_JSON;
+                } else if (strcmp(optarg, "csv") == 0) {
+                    format = OUTPUT_CSV;
+                } else if (strcmp(optarg, "bin") == 0) {
+                    format = OUTPUT_BINARY;
+                } else {
+                    fprintf(stderr, "Unknown output format: %s\n", optarg);
+                    print_usage(argv);
+                    return 1;
+                }
+                break;
             case 'p':
                 procfs_loc = optarg;
                 alt_proc = true;
@@ -739,11 +1547,35 @@ int main(int argc, char *argv[])
             case 's':
                 options.system = true;
                 break;
+            case 'S':
+                if (strcmp(optarg, "cpu") == 0) {
+                    sort_by = SORT_CPU;
+                } else if (strcmp(optarg, "mem") == 0) {
+                    sort_by = SORT_MEM;
+                } else if (strcmp(optarg, "pid") == 0) {
+                    sort_by = SORT_PID;
+                } else {
+                    fprintf(stderr, "Unknown sort key: %s\n", optarg);
+                    print_usage(argv);
+                    return 1;
+                }
+                break;
             case 't':
                 options.task_list = true;
                 break;
+            case 'w':
+                window_ms = atol(optarg);
+                window_set = true;
+                if (window_ms < 1) {
+                    fprintf(stderr, "Invalid sampling window: %s\n", optarg);
+                    print_usage(argv);
+                    return 1;
+                }
+                break;
             case '?':
-                if (optopt == 'p') {
+                if (optopt == 'p' || optopt == 'j' || optopt == 'n' || optopt == 'S'
+                    || optopt == 'w' || optopt == 'o' || optopt == 'd'
+                    || optopt == 'f' || optopt == 'N') {
                     fprintf(stderr,
                             "Option -%c requires an argument.\n", optopt);
                 } else if (isprint(optopt)) {
@@ -763,61 +1595,105 @@ int main(int argc, char *argv[])
     
     if (alt_proc == true) {
         LOG("Using alternative proc directory: %s\n", procfs_loc);
-        
-        /* Remove two arguments from the count: one for -p, one for the
-         * directory passed in: */
-        argc = argc - 2;
     }
     
-    if (argc <= 1) {
-        /* No args (or -p only). Enable default options: */
+    if (daemon_ms == 0 && format == OUTPUT_BINARY) {
+        fprintf(stderr, "Binary output is only available in daemon mode (-d)\n");
+        print_usage(argv);
+        return 1;
+    }
+    if (daemon_ms > 0 && format == OUTPUT_JSON) {
+        fprintf(stderr, "Daemon dumps are csv or bin\n");
+        print_usage(argv);
+        return 1;
+    }
+    if (dump_path != NULL && dump_path[0] != '/') {
+        /* The dump file is relative to where we started, not to procfs */
+        char cwd[PATH_MAX];
+        if (getcwd(cwd, sizeof(cwd)) == NULL) {
+            perror("getcwd");
+            return -1;
+        }
+        if (snprintf(dump_abs, sizeof(dump_abs), "%s/%s", cwd, dump_path)
+                >= (int) sizeof(dump_abs)) {
+            fprintf(stderr, "Dump path too long: %s\n", dump_path);
+            return 1;
+        }
+        dump_path = dump_abs;
+    }
+    
+    if (!options.hardware && !options.live_view
+            && !options.system && !options.task_list) {
+        /* No view options (e.g. -p or -j only). Enable default options: */
         options = defaults;
     }
     if (chdir(procfs_loc) == -1) {
         perror("ERROR CHDIR");
         return -1;
     }
+    if (daemon_ms > 0) {
+        LOG("Daemon mode enabled. Ignoring view options.%s\n", "");
+        return daemon_mode(daemon_ms, daemon_samples, format, dump_path) == 0 ? 0 : 1;
+    }
+    if (options.live_view == true) {
+        /* If live view is enabled, we will disable any other view options that
+         * were passed in. -t adds the task table to the live view. */
+        LOG("Live view enabled%s. Ignoring other view options.\n",
+            options.task_list ? " with task table" : "");
+        if (format == OUTPUT_TEXT) {
+            live_view(options.task_list, sort_by, limit,
+                      window_set ? window_ms : LIVE_INTERVAL_MS);
+        } else {
+            live_stream(format, options.task_list, sort_by, limit,
+                        window_set ? window_ms : LIVE_INTERVAL_MS);
+        }
+        return 0;
+    }
+    
+    if (format != OUTPUT_TEXT) {
+        print_report(format, options, jobs, sort_by, limit, window_ms);
+        return 0;
+    }
+    
     if (options.system) {
         printf("System Information\n--------------------\n");
         hostname();
         printkernel();
         print_uptime();
-        cpu_usage();
     }
     if (options.hardware) {
         printf("Hardware Information\n--------------------\n");
         double r;
-        double p;
-        r = mem_usage();
+        struct mem_info mem;
+        struct cpu_sample before;
+        struct cpu_sample after;
+        
+        cpu_sample_init(&before);
+        cpu_sample_init(&after);
+        r = mem_usage(&mem);
         parse_cpuinfo();
-        p = cpu_usage();
         
-        printf("\nCPU Usage: ");
-        percentage_bar(p);
-        printf("\nMemory Usage: ");
+        printf("\n");
+        if (cpu_usage(&before, &after, window_ms) == 0) {
+            print_cpu_usage(&before, &after);
+        }
+        cpu_sample_free(&before);
+        cpu_sample_free(&after);
+        printf("Memory Usage: ");
         percentage_bar_mem(r);
-        printf(" (%.1f GB / 500.0GB)\n", r);
+        printf(" (%.1f GB / %.1f GB)\n", mem.used_kb / 1048576, mem.total_kb / 1048576);
     }
     if (options.task_list) {
         printf("Task Information\n--------------------\n");
         
         taskcount();
-        num_process();
+        num_process(jobs, sort_by, limit, window_ms);
     }
     
-    if (options.live_view == true) {
-        /* If live view is enabled, we will disable any other view options that
-         * were passed in. */
-        options = defaults;
-        options.live_view = true;
-        live_view();
-        LOGP("Live view enabled. Ignoring other view options.\n");
-    } else {
-        LOG("View options selected: %s%s%s\n",
-            options.hardware ? "hardware " : "",
-            options.system ? "system " : "",
-            options.task_list ? "task_list" : "");
-    }
+    LOG("View options selected: %s%s%s\n",
+        options.hardware ? "hardware " : "",
+        options.system ? "system " : "",
+        options.task_list ? "task_list" : "");
     
     return 0;
 }
@@ -0,0 +1,182 @@
+/**
+ * @file
+ *
+ * Growable output buffer implementation, with the string quoting rules of
+ * JSON and CSV (RFC 4180).
+ */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "output.h"
+
+/**
+ * Prepares an empty buffer. Nothing is allocated until the first append.
+ * @param struct outbuf *ob - buffer to initialize
+ */
+void ob_init(struct outbuf *ob) {
+    ob->data = NULL;
+    ob->len = 0;
+    ob->cap = 0;
+}
+
+/**
+ * Makes room for at least extra more bytes plus a NUL terminator.
+ * @param struct outbuf *ob - buffer to grow
+ * @param size_t extra - bytes about to be appended
+ *
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+static int ob_reserve(struct outbuf *ob, size_t extra) {
+    size_t new_cap = ob->cap == 0 ? 4096 : ob->cap;
+    char *grown;
+
+    if (ob->len + extra + 1 <= ob->cap) {
+        return 0;
+    }
+    while (new_cap < ob->len + extra + 1) {
+        new_cap *= 2;
+    }
+    grown = realloc(ob->data, new_cap);
+    if (grown == NULL) {
+        perror("realloc");
+        return -1;
+    }
+    ob->data = grown;
+    ob->cap = new_cap;
+    return 0;
+}
+
+/**
+ * Appends printf-style formatted text.
+ * @param struct outbuf *ob - buffer to append to
+ * @param const char *fmt - format string
+ */
+void ob_printf(struct outbuf *ob, const char *fmt, ...) {
+    va_list args;
+    int n;
+
+    va_start(args, fmt);
+    n = vsnprintf(ob->data != NULL ? ob->data + ob->len : NULL,
+            ob->cap - ob->len, fmt, args);
+    va_end(args);
+    if (n < 0) {
+        return;
+    }
+
+    if (ob->len + n + 1 > ob->cap) {
+        if (ob_reserve(ob, n) == -1) {
+            return;
+        }
+        va_start(args, fmt);
+        vsnprintf(ob->data + ob->len, ob->cap - ob->len, fmt, args);
+        va_end(args);
+    }
+    ob->len += n;
+}
+
+/**
+ * Appends a string as a quoted JSON string.
+ * @param struct outbuf *ob - buffer to append to
+ * @param const char *str - string to quote
+ */
+void ob_json_str(struct outbuf *ob, const char *str) {
+    /* Worst case: every byte becomes a \u00XX escape */
+    if (ob_reserve(ob, strlen(str) * 6 + 2) == -1) {
+        return;
+    }
+
+    ob->data[ob->len++] = '"';
+    for (const unsigned char *c = (const unsigned char *) str; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            ob->data[ob->len++] = '\\';
+            ob->data[ob->len++] = *c;
+        } else if (*c < 0x20) {
+            ob->len += sprintf(ob->data + ob->len, "\\u%04x", *c);
+        } else {
+            ob->data[ob->len++] = *c;
+        }
+    }
+    ob->data[ob->len++] = '"';
+    ob->data[ob->len] = '\0';
+}
+
+/**
+ * Appends a string as a CSV field, quoting it only if it has to be.
+ * @param struct outbuf *ob - buffer to append to
+ * @param const char *str - field contents
+ */
+void ob_csv_str(struct outbuf *ob, const char *str) {
+    if (strpbrk(str, ",\"\r\n") == NULL) {
+        ob_printf(ob, "%s", str);
+        return;
+    }
+    if (ob_reserve(ob, strlen(str) * 2 + 2) == -1) {
+        return;
+    }
+
+    ob->data[ob->len++] = '"';
+    for (const char *c = str; *c; ++c) {
+        if (*c == '"') {
+            ob->data[ob->len++] = '"';
+        }
+        ob->data[ob->len++] = *c;
+    }
+    ob->data[ob->len++] = '"';
+    ob->data[ob->len] = '\0';
+}
+
+/**
+ * Writes a whole buffer, retrying after short writes and interruptions.
+ * @param int fd - destination file descriptor
+ * @param const void *buf - bytes to write
+ * @param size_t len - number of bytes
+ *
+ * @return 0 on success, -1 on error
+ */
+int write_all(int fd, const void *buf, size_t len) {
+    const char *data = buf;
+    size_t done = 0;
+
+    while (done < len) {
+        ssize_t n = write(fd, data + done, len - done);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("write");
+            return -1;
+        }
+        done += n;
+    }
+    return 0;
+}
+
+/**
+ * Writes the buffer out and empties it. The whole buffer goes to write(2) at
+ * once; the loop only matters for short writes (e.g. to a full pipe).
+ * @param struct outbuf *ob - buffer to write
+ * @param int fd - destination file descriptor
+ *
+ * @return 0 on success, -1 on error
+ */
+int ob_flush(struct outbuf *ob, int fd) {
+    int rv = write_all(fd, ob->data, ob->len);
+
+    ob->len = 0;
+    return rv;
+}
+
+/**
+ * Releases the memory held by the buffer.
+ * @param struct outbuf *ob - buffer to free
+ */
+void ob_free(struct outbuf *ob) {
+    free(ob->data);
+    ob_init(ob);
+}
@@ -0,0 +1,41 @@
+/**
+ * @file
+ *
+ * Growable output buffer for the machine-readable (JSON / CSV) modes. A whole
+ * report is built in memory and then handed to the kernel with one write.
+ */
+
+#ifndef _OUTPUT_H_
+#define _OUTPUT_H_
+
+#include <stddef.h>
+
+/**
+ * Output formats of the inspector.
+ */
+enum output_format {
+    OUTPUT_TEXT,
+    OUTPUT_JSON,
+    OUTPUT_CSV,
+    OUTPUT_BINARY,          /**< Daemon mode dumps only */
+};
+
+/**
+ * Growable character buffer.
+ */
+struct outbuf {
+    char *data;
+    size_t len;
+    size_t cap;
+};
+
+void ob_init(struct outbuf *ob);
+void ob_printf(struct outbuf *ob, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+void ob_json_str(struct outbuf *ob, const char *str);
+void ob_csv_str(struct outbuf *ob, const char *str);
+int ob_flush(struct outbuf *ob, int fd);
+int write_all(int fd, const void *buf, size_t len);
+void ob_free(struct outbuf *ob);
+
+#endif
@@ -0,0 +1,320 @@
+/**
+ * @file
+ *
+ * Buffered procfs reader implementation. Files are read with pread() from
+ * offset 0 into a single buffer that grows only when the inline storage is
+ * too small (e.g. cpuinfo on machines with many cores). Also holds the
+ * in-place parsing helpers used on the lines it hands out.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "procfs.h"
+
+/**
+ * Prepares a buffer for use. No memory is allocated until a file outgrows the
+ * inline storage.
+ * @param struct proc_buf *pb - buffer to initialize
+ */
+void pb_init(struct proc_buf *pb) {
+    pb->data = pb->inline_data;
+    pb->cap = sizeof(pb->inline_data);
+    pb->len = 0;
+    pb->pos = 0;
+    pb->heap = false;
+}
+
+/**
+ * Doubles the capacity of the buffer, moving it to the heap the first time.
+ * @param struct proc_buf *pb - buffer to grow
+ *
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+static int pb_grow(struct proc_buf *pb) {
+    size_t new_cap = pb->cap * 2;
+    char *new_data;
+
+    if (pb->heap) {
+        new_data = realloc(pb->data, new_cap);
+    } else {
+        new_data = malloc(new_cap);
+        if (new_data != NULL) {
+            memcpy(new_data, pb->data, pb->len);
+        }
+    }
+    if (new_data == NULL) {
+        return -1;
+    }
+
+    pb->data = new_data;
+    pb->cap = new_cap;
+    pb->heap = true;
+    return 0;
+}
+
+/**
+ * (Re)reads the whole file behind fd into the buffer, starting at offset 0.
+ * The file descriptor is left open, so the same fd can be sampled again.
+ * @param struct proc_buf *pb - buffer to fill
+ * @param int fd - open procfs file descriptor
+ *
+ * @return number of bytes loaded, or -1 on error
+ */
+ssize_t pb_fill(struct proc_buf *pb, int fd) {
+    ssize_t n;
+
+    pb->len = 0;
+    pb->pos = 0;
+    while (true) {
+        if (pb->cap - pb->len <= 1 && pb_grow(pb) == -1) {
+            return -1;
+        }
+        n = pread(fd, pb->data + pb->len, pb->cap - pb->len - 1, pb->len);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        pb->len += n;
+    }
+
+    pb->data[pb->len] = '\0';
+    return pb->len;
+}
+
+/**
+ * Opens, reads and closes the file at the given path (relative to the current
+ * procfs directory).
+ * @param struct proc_buf *pb - buffer to fill
+ * @param const char *path - file to read
+ *
+ * @return number of bytes loaded, or -1 on error
+ */
+ssize_t pb_load(struct proc_buf *pb, const char *path) {
+    int fd = open(path, O_RDONLY);
+    ssize_t n;
+
+    if (fd == -1) {
+        pb->len = 0;
+        pb->pos = 0;
+        pb->data[0] = '\0';
+        return -1;
+    }
+    n = pb_fill(pb, fd);
+    close(fd);
+    return n;
+}
+
+/**
+ * Hands out the next line of the buffer. The trailing newline is replaced
+ * with a NUL so the returned string points directly into the buffer.
+ * @param struct proc_buf *pb - buffer to iterate
+ *
+ * @return the next line, or NULL once the buffer is exhausted
+ */
+char *pb_next_line(struct proc_buf *pb) {
+    char *line;
+    char *nl;
+
+    if (pb->pos >= pb->len) {
+        return NULL;
+    }
+
+    line = pb->data + pb->pos;
+    nl = memchr(line, '\n', pb->len - pb->pos);
+    if (nl == NULL) {
+        pb->pos = pb->len;
+    } else {
+        *nl = '\0';
+        pb->pos = nl - pb->data + 1;
+    }
+    return line;
+}
+
+/**
+ * Releases any heap storage held by the buffer and resets it to its inline
+ * storage.
+ * @param struct proc_buf *pb - buffer to release
+ */
+void pb_free(struct proc_buf *pb) {
+    if (pb->heap) {
+        free(pb->data);
+    }
+    pb_init(pb);
+}
+
+/**
+ * Opens a procfs file for repeated sampling.
+ * @param struct proc_file *pf - file to open
+ * @param const char *path - file to read (relative to the procfs directory)
+ *
+ * @return 0 on success, -1 on error
+ */
+int pf_open(struct proc_file *pf, const char *path) {
+    pb_init(&pf->pb);
+    pf->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (pf->fd == -1) {
+        LOG("Could not open %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Re-reads the current contents of an open procfs file.
+ * @param struct proc_file *pf - file to sample
+ *
+ * @return the buffer holding the new contents, or NULL on error
+ */
+struct proc_buf *pf_read(struct proc_file *pf) {
+    if (pf->fd == -1 || pb_fill(&pf->pb, pf->fd) <= 0) {
+        pf->pb.len = 0;
+        pf->pb.pos = 0;
+        pf->pb.data[0] = '\0';
+        return NULL;
+    }
+    return &pf->pb;
+}
+
+/**
+ * Closes a sampled procfs file and releases its buffer.
+ * @param struct proc_file *pf - file to close
+ */
+void pf_close(struct proc_file *pf) {
+    if (pf->fd != -1) {
+        close(pf->fd);
+        pf->fd = -1;
+    }
+    pb_free(&pf->pb);
+}
+
+/**
+ * Retrieves the next token from a string, splitting it in place.
+ *
+ * Parameters:
+ * - str_ptr: maintains context in the string. If the function returns token
+ *   N, then str_ptr is updated to point to token N+1 (or NULL once the string
+ *   is exhausted). The delimiter that ends a token is overwritten with a NUL,
+ *   so the returned token points directly into the caller's buffer.
+ * - delim: the set of characters to use as delimiters
+ *
+ * Returns: char pointer to the next token in the string, or NULL.
+ */
+char *next_token(char **str_ptr, const char *delim)
+{
+    if (*str_ptr == NULL) {
+        return NULL;
+    }
+    
+    size_t tok_start = strspn(*str_ptr, delim);
+    size_t tok_end = strcspn(*str_ptr + tok_start, delim);
+    
+    /* Zero length token. We must be finished. */
+    if (tok_end == 0) {
+        *str_ptr = NULL;
+        return NULL;
+    }
+    
+    char *current_ptr = *str_ptr + tok_start;
+    *str_ptr += tok_start + tok_end;
+    
+    if (**str_ptr == '\0') {
+        *str_ptr = NULL;
+    } else {
+        **str_ptr = '\0';
+        (*str_ptr)++;
+    }
+    return current_ptr;
+}
+
+/**
+ * Tokenizer function breaks up the given string in place
+ * according to the delimeter and saves pointers to each
+ * token in a list. Runs of delimeters are treated as one,
+ * and no memory is allocated.
+ * @param char* retval[] - list to add the tokens
+ * @param int max - capacity of retval
+ * @param char* str1 - string to be tokenized (modified in place)
+ * @param char* delm - delimeter
+ *
+ * @return the number of tokens in retval
+ */
+int tokenize(char* retval[], int max, char* str1, const char* delm){
+    int rv = 0;
+    char* next_tok = str1;
+    char* curr_tok;
+    
+    while (rv < max && (curr_tok = next_token(&next_tok, delm)) != NULL) {
+        retval[rv++] = curr_tok;
+    }
+    return rv;
+}
+
+/**
+ * Splits a "Key: value" line in place.
+ * @param char* line - line to split (modified in place)
+ * @param char** value - set to the value with surrounding whitespace removed
+ *
+ * @return the key, or NULL if the line has no ':' separator
+ */
+char* split_field(char* line, char** value){
+    char* sep = strchr(line, ':');
+    
+    if (sep == NULL) {
+        return NULL;
+    }
+    *sep = '\0';
+    *value = trimwhitespace(sep + 1);
+    return trimwhitespace(line);
+}
+
+/**
+ * Trims the whitespace from given string
+ * @param any string containing white space
+ *
+ * @return the string without whitespace
+ */
+char *trimwhitespace(char *str)
+{
+    char *end;
+    
+    // Trim leading space
+    while(isspace((unsigned char)*str)) str++;
+    
+    if(*str == 0)  // All spaces?
+        return str;
+    
+    // Trim trailing space
+    end = str + strlen(str) - 1;
+    while(end > str && isspace((unsigned char)*end)) end--;
+    
+    // Write new null terminator character
+    end[1] = '\0';
+    
+    return str;
+}
+
+/**
+ * This checks if given number
+ * is a digit
+ * @param const char *s - any character
+ * @return
+ */
+int digits_only(const char *s) {
+    while (*s) {
+        if (isdigit(*s++) == 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
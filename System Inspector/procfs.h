@@ -0,0 +1,59 @@
+/**
+ * @file
+ *
+ * Buffered procfs reader. A file is pulled in with a few large reads and its
+ * lines are handed out in place, so parsing does not copy the data again.
+ */
+
+#ifndef _PROCFS_H_
+#define _PROCFS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * Size of the inline buffer. Most files under /proc/<pid> fit in here, so
+ * reading them does not touch the heap.
+ */
+#define PROC_BUF_SZ 4096
+
+/**
+ * Holds the contents of one procfs file along with the read position of the
+ * line iterator.
+ */
+struct proc_buf {
+    char *data;     /**< Points at inline or heap storage */
+    size_t cap;     /**< Capacity of data */
+    size_t len;     /**< Bytes currently loaded */
+    size_t pos;     /**< Start of the next line */
+    bool heap;      /**< True once data has been moved to the heap */
+    char inline_data[PROC_BUF_SZ];
+};
+
+/**
+ * A procfs file that stays open so it can be sampled repeatedly with pread()
+ * from offset 0, without reopening it.
+ */
+struct proc_file {
+    int fd;
+    struct proc_buf pb;
+};
+
+void pb_init(struct proc_buf *pb);
+ssize_t pb_fill(struct proc_buf *pb, int fd);
+ssize_t pb_load(struct proc_buf *pb, const char *path);
+char *pb_next_line(struct proc_buf *pb);
+void pb_free(struct proc_buf *pb);
+
+int pf_open(struct proc_file *pf, const char *path);
+struct proc_buf *pf_read(struct proc_file *pf);
+void pf_close(struct proc_file *pf);
+
+char *next_token(char **str_ptr, const char *delim);
+int tokenize(char* retval[], int max, char* str1, const char* delm);
+char* split_field(char* line, char** value);
+char *trimwhitespace(char *str);
+int digits_only(const char *s);
+
+#endif
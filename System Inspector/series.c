@@ -0,0 +1,141 @@
+/**
+ * @file
+ *
+ * Time series ring buffer implementation. Pushing a sample is a copy into a
+ * preallocated slot, so the sampling loop never allocates; dumps stream the
+ * ring out in at most two contiguous pieces.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "series.h"
+
+/**
+ * Allocates a ring that holds up to cap samples.
+ * @param struct series *s - ring to initialize
+ * @param size_t cap - number of samples kept
+ *
+ * @return 0 on success, -1 on error
+ */
+int series_init(struct series *s, size_t cap) {
+    s->samples = calloc(cap, sizeof(struct series_sample));
+    if (s->samples == NULL) {
+        perror("calloc");
+        return -1;
+    }
+    s->cap = cap;
+    s->head = 0;
+    s->count = 0;
+    return 0;
+}
+
+/**
+ * Appends a sample, overwriting the oldest one once the ring is full.
+ * @param struct series *s - ring to append to
+ * @param const struct series_sample *sample - sample to copy in
+ */
+void series_push(struct series *s, const struct series_sample *sample) {
+    s->samples[s->head] = *sample;
+    s->head = (s->head + 1) % s->cap;
+    if (s->count < s->cap) {
+        s->count++;
+    }
+}
+
+/**
+ * Returns the index of the oldest sample in the ring.
+ */
+static size_t series_tail(const struct series *s) {
+    return (s->head + s->cap - s->count) % s->cap;
+}
+
+/**
+ * Writes the samples as raw records after a series_header. The ring is
+ * written in place, with one write per contiguous piece.
+ */
+static int dump_binary(const struct series *s, long interval_ms, int fd) {
+    struct series_header header;
+    size_t tail = series_tail(s);
+    size_t first = s->count < s->cap - tail ? s->count : s->cap - tail;
+
+    memset(&header, 0, sizeof(header));
+    strcpy(header.magic, SERIES_MAGIC);
+    header.version = SERIES_VERSION;
+    header.sample_size = sizeof(struct series_sample);
+    header.count = s->count;
+    header.interval_ms = interval_ms;
+
+    if (write_all(fd, &header, sizeof(header)) == -1
+            || write_all(fd, s->samples + tail,
+                first * sizeof(struct series_sample)) == -1
+            || write_all(fd, s->samples,
+                (s->count - first) * sizeof(struct series_sample)) == -1) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Writes the samples as CSV rows, oldest first. Rows are gathered in a fixed
+ * stack buffer, so dumping does not allocate either.
+ */
+static int dump_csv(const struct series *s, int fd) {
+    char buf[8192];
+    size_t len;
+    size_t tail = series_tail(s);
+
+    len = snprintf(buf, sizeof(buf), "time,cpu_usage,cpu_user,cpu_system,"
+            "cpu_iowait,load_1,load_5,load_15,mem_used_kb,mem_total_kb,tasks\n");
+    for (size_t i = 0; i < s->count; ++i) {
+        const struct series_sample *x = &s->samples[(tail + i) % s->cap];
+
+        /* A row is well under 256 bytes */
+        if (sizeof(buf) - len < 256) {
+            if (write_all(fd, buf, len) == -1) {
+                return -1;
+            }
+            len = 0;
+        }
+        len += snprintf(buf + len, sizeof(buf) - len,
+                "%" PRIu64 ".%03u,%.4f,%.4f,%.4f,%.4f,%.2f,%.2f,%.2f,"
+                "%" PRIu64 ",%" PRIu64 ",%" PRIu32 "\n",
+                x->time_ms / 1000, (unsigned) (x->time_ms % 1000),
+                x->cpu_busy, x->cpu_user, x->cpu_system, x->cpu_iowait,
+                x->load[0], x->load[1], x->load[2],
+                x->mem_used_kb, x->mem_total_kb, x->tasks);
+    }
+    return write_all(fd, buf, len);
+}
+
+/**
+ * Writes every sample in the ring, oldest first.
+ * @param const struct series *s - ring to dump
+ * @param enum output_format format - OUTPUT_BINARY, otherwise CSV
+ * @param long interval_ms - sampling interval, recorded in binary dumps
+ * @param int fd - destination file descriptor
+ *
+ * @return 0 on success, -1 on error
+ */
+int series_dump(const struct series *s, enum output_format format,
+        long interval_ms, int fd) {
+    if (format == OUTPUT_BINARY) {
+        return dump_binary(s, interval_ms, fd);
+    }
+    return dump_csv(s, fd);
+}
+
+/**
+ * Releases the storage of the ring.
+ * @param struct series *s - ring to free
+ */
+void series_free(struct series *s) {
+    free(s->samples);
+    s->samples = NULL;
+    s->cap = 0;
+    s->head = 0;
+    s->count = 0;
+}
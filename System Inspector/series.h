@@ -0,0 +1,66 @@
+/**
+ * @file
+ *
+ * Fixed-size time series for the sampling daemon. All storage is allocated up
+ * front; once the ring is full the oldest sample is overwritten.
+ */
+
+#ifndef _SERIES_H_
+#define _SERIES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "output.h"
+
+/** Magic bytes at the start of a binary dump */
+#define SERIES_MAGIC "INSPSER"
+
+/** Version of the binary dump layout */
+#define SERIES_VERSION 1
+
+/**
+ * One sample of the time series. This is also the on-disk record of a binary
+ * dump (host byte order), so every field has a fixed width and the struct
+ * has no padding.
+ */
+struct series_sample {
+    uint64_t time_ms;       /**< Wall clock time, in ms since the epoch */
+    uint64_t mem_used_kb;
+    uint64_t mem_total_kb;
+    float load[3];          /**< 1, 5 and 15 minute load averages */
+    float cpu_busy;         /**< Fractions of the elapsed CPU time */
+    float cpu_user;
+    float cpu_system;
+    float cpu_iowait;
+    uint32_t tasks;         /**< Number of processes */
+};
+
+/**
+ * Header of a binary dump, followed by count samples, oldest first.
+ */
+struct series_header {
+    char magic[8];          /**< SERIES_MAGIC, NUL terminated */
+    uint32_t version;       /**< SERIES_VERSION */
+    uint32_t sample_size;   /**< sizeof(struct series_sample) */
+    uint64_t count;
+    uint64_t interval_ms;
+};
+
+/**
+ * Ring buffer of samples.
+ */
+struct series {
+    struct series_sample *samples;
+    size_t cap;
+    size_t head;            /**< Slot the next sample goes into */
+    size_t count;
+};
+
+int series_init(struct series *s, size_t cap);
+void series_push(struct series *s, const struct series_sample *sample);
+int series_dump(const struct series *s, enum output_format format,
+        long interval_ms, int fd);
+void series_free(struct series *s);
+
+#endif
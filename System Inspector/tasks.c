@@ -0,0 +1,854 @@
+/**
+ * @file
+ *
+ * Task list scanner implementation. The PIDs found in the procfs directory
+ * are split into contiguous chunks, one per worker thread. Each worker parses
+ * its chunk into its own row buffer, and the buffers are concatenated in
+ * chunk order to form the final table.
+ *
+ * The live view keeps its rows in a task_map instead. Each refresh re-reads
+ * only /proc/<pid>/stat for known PIDs, parses the status file of new PIDs,
+ * and drops the PIDs that have disappeared.
+ */
+
+#include <dirent.h>
+#include <pthread.h>
+#include <pwd.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "procfs.h"
+#include "tasks.h"
+
+/**
+ * State for one worker thread of the scanner.
+ */
+struct scan_worker {
+    const pid_t *pids;          /**< First PID of this worker's chunk */
+    size_t npids;               /**< Number of PIDs in the chunk */
+    struct task_row *rows;      /**< Per-thread row buffer */
+    size_t nrows;               /**< Rows parsed successfully */
+    struct user_cache users;
+};
+
+/**
+ * State for one worker thread of the CPU sampler.
+ */
+struct sample_worker {
+    struct task_row *rows;      /**< First row of this worker's chunk */
+    size_t nrows;               /**< Number of rows in the chunk */
+};
+
+/**
+ * Returns the number of worker threads to use when none was requested: the
+ * number of online CPUs.
+ */
+int default_jobs(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n < 1 ? 1 : (int) n;
+}
+
+/**
+ * qsort comparator for PIDs.
+ */
+static int compare_pids(const void *a, const void *b) {
+    pid_t pa = *(const pid_t *) a;
+    pid_t pb = *(const pid_t *) b;
+    return (pa > pb) - (pa < pb);
+}
+
+/**
+ * Resolves a UID to a user name. getpwuid() is not thread safe, so this uses
+ * getpwuid_r() and remembers the last answer, since most consecutive tasks
+ * belong to the same user.
+ * @param struct user_cache *cache - cache owned by the calling thread
+ * @param uid_t uid - UID to resolve
+ * @param char *user - destination for the user name
+ * @param size_t sz - size of user
+ */
+static void lookup_user(struct user_cache *cache, uid_t uid, char *user, size_t sz) {
+    struct passwd pw;
+    struct passwd *result = NULL;
+    char buf[1024];
+
+    if (!cache->valid || cache->uid != uid) {
+        if (getpwuid_r(uid, &pw, buf, sizeof(buf), &result) == 0
+                && result != NULL) {
+            snprintf(cache->name, sizeof(cache->name), "%s", pw.pw_name);
+        } else {
+            snprintf(cache->name, sizeof(cache->name), "%u", (unsigned) uid);
+        }
+        cache->uid = uid;
+        cache->valid = true;
+    }
+    snprintf(user, sz, "%s", cache->name);
+}
+
+/**
+ * Parses /proc/<pid>/status into a task row.
+ * @param struct user_cache *users - UID lookup cache of the calling thread
+ * @param struct proc_buf *pb - buffer to read the file with
+ * @param pid_t pid - process to read
+ * @param struct task_row *row - row to fill in
+ *
+ * @return 0 on success, -1 if the process could not be read (e.g. it exited)
+ */
+static int read_status(struct user_cache *users, struct proc_buf *pb, pid_t pid,
+        struct task_row *row) {
+    char path[32];
+    char *line;
+
+    snprintf(path, sizeof(path), "%d/status", (int) pid);
+    if (pb_load(pb, path) <= 0) {
+        return -1;
+    }
+
+    memset(row, 0, sizeof(*row));
+    row->pid = pid;
+
+    while ((line = pb_next_line(pb)) != NULL) {
+        char *key;
+        char *value;
+
+        key = split_field(line, &value);
+        if (key == NULL) {
+            continue;
+        }
+
+        if (strcmp(key, "Name") == 0) {
+            snprintf(row->name, sizeof(row->name), "%s", value);
+        } else if (strcmp(key, "State") == 0) {
+            /* "S (sleeping)": keep the text inside the parens */
+            char *open_paren = strchr(value, '(');
+            char *close_paren = strrchr(value, ')');
+
+            if (open_paren != NULL && close_paren > open_paren) {
+                *close_paren = '\0';
+                value = open_paren + 1;
+            }
+            snprintf(row->state, sizeof(row->state), "%s", value);
+        } else if (strcmp(key, "Uid") == 0) {
+            char *uid_tok = next_token(&value, " \t");
+            row->uid = (uid_tok != NULL) ? (uid_t) atoi(uid_tok) : 0;
+            lookup_user(users, row->uid, row->user, sizeof(row->user));
+        } else if (strcmp(key, "Threads") == 0) {
+            row->threads = atoi(value);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Runs fn on each of the jobs argument structs stored back to back in args,
+ * one thread per struct. The first one runs on the calling thread, and so
+ * does any whose thread can't be created.
+ * @param void *(*fn)(void *) - worker entrypoint
+ * @param void *args - array of jobs argument structs
+ * @param size_t arg_size - size of one argument struct
+ * @param int jobs - number of argument structs
+ */
+static void run_parallel(void *(*fn)(void *), void *args, size_t arg_size, int jobs) {
+    pthread_t threads[jobs];
+    bool started[jobs];
+
+    for (int i = 1; i < jobs; ++i) {
+        started[i] = pthread_create(&threads[i], NULL, fn,
+                (char *) args + i * arg_size) == 0;
+    }
+    fn(args);
+    for (int i = 1; i < jobs; ++i) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        } else {
+            fn((char *) args + i * arg_size);
+        }
+    }
+}
+
+/**
+ * Returns the value of the monotonic clock in seconds.
+ */
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Converts the CPU ticks a task used over a sampling window into a
+ * percentage of one CPU.
+ * @param unsigned long long prev_ticks - utime + stime at the first sample
+ * @param unsigned long long ticks - utime + stime at the second sample
+ * @param double elapsed - seconds between the two samples
+ *
+ * @return CPU usage in percent
+ */
+static double cpu_percent(unsigned long long prev_ticks, unsigned long long ticks,
+        double elapsed) {
+    static long clk_tck = 0;
+
+    if (clk_tck == 0) {
+        clk_tck = sysconf(_SC_CLK_TCK);
+    }
+    if (elapsed <= 0 || ticks < prev_ticks || clk_tck <= 0) {
+        return 0;
+    }
+    return 100.0 * (ticks - prev_ticks) / clk_tck / elapsed;
+}
+
+/**
+ * Worker thread entrypoint: parses every PID in the worker's chunk.
+ * @param void *arg - the struct scan_worker to run
+ */
+static void *scan_worker_main(void *arg) {
+    struct scan_worker *w = arg;
+    struct proc_buf pb;
+
+    pb_init(&pb);
+    for (size_t i = 0; i < w->npids; ++i) {
+        if (read_status(&w->users, &pb, w->pids[i], &w->rows[w->nrows]) == 0
+                && task_read_stat(&pb, w->pids[i], &w->rows[w->nrows]) == 0) {
+            w->nrows++;
+        }
+    }
+    pb_free(&pb);
+    return NULL;
+}
+
+/**
+ * Collects the numeric entries of the current (procfs) directory.
+ * @param pid_t **out - set to a heap array of PIDs in ascending order
+ * @param size_t *count - set to the number of PIDs found
+ *
+ * @return 0 on success, -1 on error
+ */
+static int list_pids(pid_t **out, size_t *count) {
+    DIR *d = opendir("./");
+    struct dirent *dir;
+    pid_t *pids = NULL;
+    size_t cap = 0;
+
+    *out = NULL;
+    *count = 0;
+    if (d == NULL) {
+        perror("opendir");
+        return -1;
+    }
+
+    while ((dir = readdir(d)) != NULL) {
+        if (!digits_only(dir->d_name)) {
+            continue;
+        }
+        if (*count == cap) {
+            size_t new_cap = cap == 0 ? 256 : cap * 2;
+            pid_t *new_pids = realloc(pids, new_cap * sizeof(pid_t));
+            if (new_pids == NULL) {
+                perror("realloc");
+                free(pids);
+                closedir(d);
+                *count = 0;
+                return -1;
+            }
+            pids = new_pids;
+            cap = new_cap;
+        }
+        pids[(*count)++] = (pid_t) atoi(dir->d_name);
+    }
+    closedir(d);
+
+    qsort(pids, *count, sizeof(pid_t), compare_pids);
+    *out = pids;
+    return 0;
+}
+
+/**
+ * Builds the task table using up to the given number of worker threads.
+ * @param struct task_table *table - table to fill; free with task_table_free
+ * @param int jobs - number of worker threads (values < 1 mean one)
+ *
+ * @return 0 on success, -1 on error
+ */
+int task_scan(struct task_table *table, int jobs) {
+    struct scan_worker *workers;
+    pid_t *pids;
+    size_t count;
+    size_t offset = 0;
+    size_t total = 0;
+
+    table->rows = NULL;
+    table->count = 0;
+    table->sampled = now_seconds();
+
+    if (list_pids(&pids, &count) == -1) {
+        return -1;
+    }
+    if (count == 0) {
+        free(pids);
+        return 0;
+    }
+
+    if (jobs < 1) {
+        jobs = 1;
+    }
+    if ((size_t) jobs > count) {
+        jobs = count;
+    }
+
+    workers = calloc(jobs, sizeof(struct scan_worker));
+    if (workers == NULL) {
+        perror("calloc");
+        free(pids);
+        return -1;
+    }
+
+    for (int i = 0; i < jobs; ++i) {
+        struct scan_worker *w = &workers[i];
+
+        w->pids = pids + offset;
+        w->npids = count / jobs + ((size_t) i < count % jobs ? 1 : 0);
+        w->rows = malloc(w->npids * sizeof(struct task_row));
+        offset += w->npids;
+        if (w->rows == NULL) {
+            perror("malloc");
+            w->npids = 0;
+        }
+    }
+
+    run_parallel(scan_worker_main, workers, sizeof(struct scan_worker), jobs);
+    table->sampled = (table->sampled + now_seconds()) / 2;
+    for (int i = 0; i < jobs; ++i) {
+        total += workers[i].nrows;
+    }
+
+    /* Merge the per-thread buffers. Chunks are contiguous ranges of the sorted
+     * PID list, so concatenating them in order keeps the table sorted. */
+    table->rows = malloc((total > 0 ? total : 1) * sizeof(struct task_row));
+    if (table->rows == NULL) {
+        perror("malloc");
+    }
+    for (int i = 0; i < jobs; ++i) {
+        if (table->rows != NULL) {
+            memcpy(table->rows + table->count, workers[i].rows,
+                    workers[i].nrows * sizeof(struct task_row));
+            table->count += workers[i].nrows;
+        }
+        free(workers[i].rows);
+    }
+
+    LOG("Scanned %zu tasks with %d worker(s)\n", table->count, jobs);
+
+    free(workers);
+    free(pids);
+    return table->rows == NULL ? -1 : 0;
+}
+
+/**
+ * Sampler thread entrypoint: re-reads /proc/<pid>/stat for every row in the
+ * worker's chunk. Until the sampling window is known, row->cpu holds the raw
+ * tick difference.
+ * @param void *arg - the struct sample_worker to run
+ */
+static void *sample_worker_main(void *arg) {
+    struct sample_worker *w = arg;
+    struct proc_buf pb;
+
+    pb_init(&pb);
+    for (size_t i = 0; i < w->nrows; ++i) {
+        struct task_row *row = &w->rows[i];
+        unsigned long long prev_ticks = row->utime + row->stime;
+
+        /* A task that exited since the scan keeps cpu = 0 */
+        row->cpu = 0;
+        if (task_read_stat(&pb, row->pid, row) == 0
+                && row->utime + row->stime >= prev_ticks) {
+            row->cpu = row->utime + row->stime - prev_ticks;
+        }
+    }
+    pb_free(&pb);
+    return NULL;
+}
+
+/**
+ * Takes a second sample of every row once interval_ms have passed since the
+ * scan and fills in the CPU usage of each task.
+ * @param struct task_table *table - table produced by task_scan
+ * @param int jobs - number of worker threads (values < 1 mean one)
+ * @param long interval_ms - sampling window, in milliseconds
+ *
+ * @return 0 on success, -1 on error
+ */
+int task_sample_cpu(struct task_table *table, int jobs, long interval_ms) {
+    struct sample_worker *workers;
+    size_t offset = 0;
+    double wait;
+    double start;
+    double elapsed;
+
+    if (table->count == 0) {
+        return 0;
+    }
+    if (jobs < 1) {
+        jobs = 1;
+    }
+    if ((size_t) jobs > table->count) {
+        jobs = table->count;
+    }
+
+    workers = calloc(jobs, sizeof(struct sample_worker));
+    if (workers == NULL) {
+        perror("calloc");
+        return -1;
+    }
+    for (int i = 0; i < jobs; ++i) {
+        workers[i].rows = table->rows + offset;
+        workers[i].nrows = table->count / jobs
+            + ((size_t) i < table->count % jobs ? 1 : 0);
+        offset += workers[i].nrows;
+    }
+
+    wait = table->sampled + interval_ms / 1000.0 - now_seconds();
+    if (wait > 0) {
+        usleep((useconds_t) (wait * 1e6));
+    }
+
+    start = now_seconds();
+    run_parallel(sample_worker_main, workers, sizeof(struct sample_worker), jobs);
+    /* Both passes are timed at their midpoint */
+    elapsed = (start + now_seconds()) / 2 - table->sampled;
+
+    for (size_t i = 0; i < table->count; ++i) {
+        table->rows[i].cpu = cpu_percent(0, table->rows[i].cpu, elapsed);
+    }
+
+    free(workers);
+    return 0;
+}
+
+/**
+ * Releases the memory held by a task table.
+ * @param struct task_table *table - table to free
+ */
+void task_table_free(struct task_table *table) {
+    free(table->rows);
+    table->rows = NULL;
+    table->count = 0;
+}
+
+/**
+ * Converts the one-letter state of /proc/<pid>/stat into the name used in
+ * /proc/<pid>/status.
+ * @param char c - state letter
+ *
+ * @return the state name
+ */
+static const char *state_name(char c) {
+    switch (c) {
+        case 'R':
+            return "running";
+        case 'S':
+            return "sleeping";
+        case 'D':
+            return "disk sleep";
+        case 'T':
+            return "stopped";
+        case 't':
+            return "tracing stop";
+        case 'X':
+            return "dead";
+        case 'Z':
+            return "zombie";
+        case 'P':
+            return "parked";
+        case 'I':
+            return "idle";
+        default:
+            return "unknown";
+    }
+}
+
+/**
+ * Refreshes the fields of a row that change over time (state, thread count,
+ * CPU times, resident set size) from /proc/<pid>/stat. Name, UID and user are
+ * left untouched.
+ * @param struct proc_buf *pb - buffer to read the file with
+ * @param pid_t pid - process to read
+ * @param struct task_row *row - row to update
+ *
+ * @return 0 on success, -1 if the process could not be read (e.g. it exited)
+ */
+int task_read_stat(struct proc_buf *pb, pid_t pid, struct task_row *row) {
+    static unsigned long long page_kb = 0;
+    char path[32];
+    char *next_tok;
+    char *curr_tok;
+    int field = 0;
+
+    if (page_kb == 0) {
+        page_kb = sysconf(_SC_PAGESIZE) / 1024;
+    }
+
+    snprintf(path, sizeof(path), "%d/stat", (int) pid);
+    if (pb_load(pb, path) <= 0) {
+        return -1;
+    }
+
+    /* The command name is in parens and may itself contain spaces or parens,
+     * so start after the last ')'. Field 0 below is the state (field 3 in
+     * proc(5)). */
+    next_tok = strrchr(pb->data, ')');
+    if (next_tok == NULL) {
+        return -1;
+    }
+    next_tok++;
+
+    while ((curr_tok = next_token(&next_tok, " \n")) != NULL) {
+        switch (field) {
+            case 0:
+                snprintf(row->state, sizeof(row->state), "%s",
+                        state_name(curr_tok[0]));
+                break;
+            case 11:
+                row->utime = strtoull(curr_tok, NULL, 10);
+                break;
+            case 12:
+                row->stime = strtoull(curr_tok, NULL, 10);
+                break;
+            case 17:
+                row->threads = atoi(curr_tok);
+                break;
+            case 19:
+                row->starttime = strtoull(curr_tok, NULL, 10);
+                break;
+            case 21:
+                row->rss = strtoull(curr_tok, NULL, 10) * page_kb;
+                break;
+        }
+        if (++field > 21) {
+            break;
+        }
+    }
+    return field > 21 ? 0 : -1;
+}
+
+/**
+ * Hashes a PID into the slot array (Fibonacci hashing).
+ */
+static size_t map_hash(const struct task_map *map, pid_t pid) {
+    return ((size_t) (unsigned) pid * 2654435761u) & (map->cap - 1);
+}
+
+/**
+ * Finds the slot holding pid, or the empty slot where it would be inserted.
+ * @param struct task_map *map - map to search
+ * @param pid_t pid - PID to look for
+ *
+ * @return slot index
+ */
+static size_t map_find(const struct task_map *map, pid_t pid) {
+    size_t i = map_hash(map, pid);
+
+    while (map->slots[i].row.pid != 0 && map->slots[i].row.pid != pid) {
+        i = (i + 1) & (map->cap - 1);
+    }
+    return i;
+}
+
+/**
+ * Doubles the number of slots and re-inserts every row.
+ * @param struct task_map *map - map to grow
+ *
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+static int map_grow(struct task_map *map) {
+    struct task_slot *old_slots = map->slots;
+    size_t old_cap = map->cap;
+
+    map->slots = calloc(old_cap * 2, sizeof(struct task_slot));
+    if (map->slots == NULL) {
+        perror("calloc");
+        map->slots = old_slots;
+        return -1;
+    }
+    map->cap = old_cap * 2;
+
+    for (size_t i = 0; i < old_cap; ++i) {
+        if (old_slots[i].row.pid != 0) {
+            map->slots[map_find(map, old_slots[i].row.pid)] = old_slots[i];
+        }
+    }
+    free(old_slots);
+    return 0;
+}
+
+/**
+ * Empties slot i, shifting later entries of the same probe run back so that
+ * lookups never hit a hole (no tombstones needed).
+ * @param struct task_map *map - map to update
+ * @param size_t i - occupied slot to empty
+ */
+static void map_remove_at(struct task_map *map, size_t i) {
+    size_t mask = map->cap - 1;
+    size_t j = i;
+
+    while (true) {
+        size_t home;
+
+        j = (j + 1) & mask;
+        if (map->slots[j].row.pid == 0) {
+            break;
+        }
+        /* Entry j may fill the hole only if its home slot is not in the
+         * cyclic range (i, j]. */
+        home = map_hash(map, map->slots[j].row.pid);
+        if ((i <= j) ? (i < home && home <= j) : (i < home || home <= j)) {
+            continue;
+        }
+        map->slots[i] = map->slots[j];
+        i = j;
+    }
+    map->slots[i].row.pid = 0;
+    map->count--;
+}
+
+/**
+ * Prepares an empty task map.
+ * @param struct task_map *map - map to initialize
+ *
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+int task_map_init(struct task_map *map) {
+    map->cap = 1024;
+    map->count = 0;
+    map->tick = 0;
+    map->sampled = 0;
+    map->users.valid = false;
+    map->slots = calloc(map->cap, sizeof(struct task_slot));
+    if (map->slots == NULL) {
+        perror("calloc");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Brings the map up to date with the procfs directory. Known PIDs only have
+ * /proc/<pid>/stat re-read; new PIDs (or reused ones, detected through their
+ * start time) are parsed in full; PIDs that are gone are dropped.
+ * @param struct task_map *map - map to refresh
+ * @param struct proc_buf *pb - buffer to read files with
+ *
+ * @return 0 on success, -1 on error
+ */
+int task_map_refresh(struct task_map *map, struct proc_buf *pb) {
+    DIR *d = opendir("./");
+    struct dirent *dir;
+    double now = now_seconds();
+    double elapsed = map->tick > 0 ? now - map->sampled : 0;
+
+    if (d == NULL) {
+        perror("opendir");
+        return -1;
+    }
+
+    map->sampled = now;
+    map->tick++;
+    while ((dir = readdir(d)) != NULL) {
+        struct task_slot *slot;
+        pid_t pid;
+
+        if (!digits_only(dir->d_name)) {
+            continue;
+        }
+        pid = (pid_t) atoi(dir->d_name);
+        slot = &map->slots[map_find(map, pid)];
+
+        if (slot->row.pid == pid) {
+            unsigned long long start = slot->row.starttime;
+            unsigned long long prev_ticks = slot->row.utime + slot->row.stime;
+
+            if (task_read_stat(pb, pid, &slot->row) == -1) {
+                continue;
+            }
+            if (slot->row.starttime != start) {
+                if (read_status(&map->users, pb, pid, &slot->row) == -1
+                        || task_read_stat(pb, pid, &slot->row) == -1) {
+                    continue;
+                }
+                prev_ticks = slot->row.utime + slot->row.stime;
+            }
+            slot->row.cpu = cpu_percent(prev_ticks,
+                    slot->row.utime + slot->row.stime, elapsed);
+            slot->tick = map->tick;
+        } else {
+            struct task_row row;
+
+            if (read_status(&map->users, pb, pid, &row) == -1
+                    || task_read_stat(pb, pid, &row) == -1) {
+                continue;
+            }
+            /* Keep the load factor at or below 1/2. */
+            if ((map->count + 1) * 2 > map->cap) {
+                if (map_grow(map) == -1) {
+                    continue;
+                }
+                slot = &map->slots[map_find(map, pid)];
+            }
+            slot->row = row;
+            slot->tick = map->tick;
+            map->count++;
+        }
+    }
+    closedir(d);
+
+    /* Drop the PIDs not seen on this tick. A removal can shift a later entry
+     * into slot i, so slot i is checked again before moving on. */
+    for (size_t i = 0; i < map->cap; ) {
+        if (map->slots[i].row.pid != 0 && map->slots[i].tick != map->tick) {
+            map_remove_at(map, i);
+        } else {
+            ++i;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Lists the rows of the map, in no particular order (see task_top).
+ * @param struct task_map *map - map to list
+ * @param struct task_row **out - array receiving row pointers
+ * @param size_t max - capacity of out; should be at least map->count
+ *
+ * @return number of pointers stored in out
+ */
+size_t task_map_rows(struct task_map *map, struct task_row **out, size_t max) {
+    size_t n = 0;
+
+    for (size_t i = 0; i < map->cap && n < max; ++i) {
+        if (map->slots[i].row.pid != 0) {
+            out[n++] = &map->slots[i].row;
+        }
+    }
+    return n;
+}
+
+/**
+ * qsort comparator for row pointers, ordering by PID.
+ */
+static int compare_row_pids(const void *a, const void *b) {
+    pid_t pa = (*(struct task_row * const *) a)->pid;
+    pid_t pb = (*(struct task_row * const *) b)->pid;
+    return (pa > pb) - (pa < pb);
+}
+
+/**
+ * qsort comparator for row pointers, highest CPU usage first. Ties are broken
+ * by PID so that no two rows compare equal.
+ */
+static int compare_row_cpu(const void *a, const void *b) {
+    const struct task_row *ra = *(struct task_row * const *) a;
+    const struct task_row *rb = *(struct task_row * const *) b;
+
+    if (ra->cpu != rb->cpu) {
+        return ra->cpu > rb->cpu ? -1 : 1;
+    }
+    return compare_row_pids(a, b);
+}
+
+/**
+ * qsort comparator for row pointers, largest resident set first. Ties are
+ * broken by PID.
+ */
+static int compare_row_mem(const void *a, const void *b) {
+    const struct task_row *ra = *(struct task_row * const *) a;
+    const struct task_row *rb = *(struct task_row * const *) b;
+
+    if (ra->rss != rb->rss) {
+        return ra->rss > rb->rss ? -1 : 1;
+    }
+    return compare_row_pids(a, b);
+}
+
+/**
+ * Partially orders rows (quickselect) so that rows[0..k) hold the first k
+ * rows under cmp, in no particular order.
+ */
+static void select_top(struct task_row **rows, size_t n, size_t k,
+        int (*cmp)(const void *, const void *)) {
+    size_t lo = 0;
+    size_t hi = n;
+
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        size_t store = lo;
+        struct task_row *tmp;
+
+        /* Lomuto partition around the middle element, parked at hi - 1 */
+        tmp = rows[mid];
+        rows[mid] = rows[hi - 1];
+        rows[hi - 1] = tmp;
+        for (size_t i = lo; i < hi - 1; ++i) {
+            if (cmp(&rows[i], &rows[hi - 1]) < 0) {
+                tmp = rows[i];
+                rows[i] = rows[store];
+                rows[store++] = tmp;
+            }
+        }
+        tmp = rows[store];
+        rows[store] = rows[hi - 1];
+        rows[hi - 1] = tmp;
+
+        if (store == k) {
+            return;
+        } else if (store < k) {
+            lo = store + 1;
+        } else {
+            hi = store;
+        }
+    }
+}
+
+/**
+ * Puts the first k rows under the given order at the front of the array,
+ * sorted. Only those k rows are fully sorted; the rest are just partitioned
+ * away, so picking the top few of many tasks stays O(n).
+ * @param struct task_row **rows - row pointers to order
+ * @param size_t n - number of rows
+ * @param size_t k - number of rows wanted
+ * @param enum task_sort by - order to use
+ *
+ * @return number of rows placed at the front (min(k, n))
+ */
+size_t task_top(struct task_row **rows, size_t n, size_t k, enum task_sort by) {
+    int (*cmp)(const void *, const void *) = compare_row_pids;
+
+    if (by == SORT_CPU) {
+        cmp = compare_row_cpu;
+    } else if (by == SORT_MEM) {
+        cmp = compare_row_mem;
+    }
+
+    if (k > n) {
+        k = n;
+    }
+    if (k < n) {
+        select_top(rows, n, k, cmp);
+    }
+    qsort(rows, k, sizeof(struct task_row *), cmp);
+    return k;
+}
+
+/**
+ * Releases the memory held by a task map.
+ * @param struct task_map *map - map to free
+ */
+void task_map_free(struct task_map *map) {
+    free(map->slots);
+    map->slots = NULL;
+    map->cap = 0;
+    map->count = 0;
+}
@@ -0,0 +1,94 @@
+/**
+ * @file
+ *
+ * Task list scanner. Reads /proc/<pid>/status for every process, splitting
+ * the work across a pool of worker threads. A PID-indexed task map keeps rows
+ * across live view ticks so only /proc/<pid>/stat has to be re-read.
+ */
+
+#ifndef _TASKS_H_
+#define _TASKS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "procfs.h"
+
+/**
+ * One row of the task table.
+ */
+struct task_row {
+    pid_t pid;
+    uid_t uid;
+    int threads;
+    unsigned long long utime;       /**< User time, in clock ticks */
+    unsigned long long stime;       /**< System time, in clock ticks */
+    unsigned long long starttime;   /**< Start time; tells reused PIDs apart */
+    unsigned long long rss;         /**< Resident set size, in kB */
+    double cpu;                     /**< CPU usage over the last sampling window, in percent of one CPU */
+    char state[13];
+    char name[26];
+    char user[16];
+};
+
+/**
+ * Task table, ordered by PID.
+ */
+struct task_table {
+    struct task_row *rows;
+    size_t count;
+    double sampled;         /**< Monotonic time of the scan, in seconds */
+};
+
+/**
+ * Orders in which the task table can be listed.
+ */
+enum task_sort {
+    SORT_PID,
+    SORT_CPU,
+    SORT_MEM,
+};
+
+/**
+ * Remembers the last UID to user name lookup.
+ */
+struct user_cache {
+    bool valid;
+    uid_t uid;
+    char name[16];
+};
+
+/**
+ * Slot of the task map. A pid of 0 marks an empty slot.
+ */
+struct task_slot {
+    struct task_row row;
+    unsigned int tick;      /**< Last refresh that saw this PID */
+};
+
+/**
+ * Open-addressing (linear probing) hash table of task rows keyed by PID.
+ */
+struct task_map {
+    struct task_slot *slots;
+    size_t cap;             /**< Number of slots, always a power of two */
+    size_t count;           /**< Number of occupied slots */
+    unsigned int tick;
+    double sampled;         /**< Monotonic time of the last refresh */
+    struct user_cache users;
+};
+
+int default_jobs(void);
+int task_scan(struct task_table *table, int jobs);
+int task_sample_cpu(struct task_table *table, int jobs, long interval_ms);
+void task_table_free(struct task_table *table);
+size_t task_top(struct task_row **rows, size_t n, size_t k, enum task_sort by);
+
+int task_read_stat(struct proc_buf *pb, pid_t pid, struct task_row *row);
+int task_map_init(struct task_map *map);
+int task_map_refresh(struct task_map *map, struct proc_buf *pb);
+size_t task_map_rows(struct task_map *map, struct task_row **out, size_t max);
+void task_map_free(struct task_map *map);
+
+#endif